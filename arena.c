@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define HUGE_PAGE_SIZE (2UL << 20) // 2 MiB, the common x86-64 and ARM64 huge page size.
+
+/**
+ * @brief Maps an arena, trying explicit huge pages first only if explicit_huge_pages is set.
+ */
+static cl_int MapArena(size_t capacity, bool explicit_huge_pages, HostArena *arena)
+{
+    void *base = MAP_FAILED;
+
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->offset = 0;
+    arena->peak = 0;
+    arena->huge_pages = false;
+
+    if (capacity == 0)
+        return CL_INVALID_VALUE;
+
+#ifdef MAP_HUGETLB
+    if (explicit_huge_pages)
+    {
+        // Explicit huge pages need whole pages from the reserved pool.  They are not mapped
+        // with MAP_NORESERVE so that an undersized pool fails here instead of faulting later.
+        size_t huge_capacity = (capacity + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        base = mmap(NULL, huge_capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            capacity = huge_capacity;
+            arena->huge_pages = true;
+        }
+    }
+#else
+    (void)explicit_huge_pages;
+#endif
+
+    if (base == MAP_FAILED)
+    {
+        base = mmap(NULL, capacity, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED)
+            return CL_OUT_OF_HOST_MEMORY;
+
+#ifdef MADV_HUGEPAGE
+        // Fall back to transparent huge pages where the kernel supports them.
+        if (madvise(base, capacity, MADV_HUGEPAGE) == 0)
+            arena->huge_pages = true;
+#endif
+    }
+
+    arena->base = (char *)base;
+    arena->capacity = capacity;
+
+    return CL_SUCCESS;
+}
+
+cl_int CreateArena(size_t capacity, HostArena *arena)
+{
+    return MapArena(capacity, true, arena);
+}
+
+cl_int CreateReservedArena(size_t capacity, HostArena *arena)
+{
+    return MapArena(capacity, false, arena);
+}
+
+void *AllocFromArena(HostArena *arena, size_t bytes, size_t alignment)
+{
+    if (alignment == 0)
+        alignment = ARENA_DEFAULT_ALIGNMENT;
+
+    uintptr_t start = (uintptr_t)arena->base + arena->offset;
+    uintptr_t aligned = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    size_t offset = aligned - (uintptr_t)arena->base;
+
+    if (offset > arena->capacity || bytes > arena->capacity - offset)
+        return NULL; // Arena exhausted
+
+    arena->offset = offset + bytes;
+    if (arena->offset > arena->peak)
+        arena->peak = arena->offset;
+
+    return (void *)aligned;
+}
+
+void *ArenaAllocator(size_t bytes, void *arena)
+{
+    return AllocFromArena((HostArena *)arena, bytes, 0);
+}
+
+void ResetArena(HostArena *arena)
+{
+    arena->offset = 0;
+}
+
+size_t GetArenaPeak(const HostArena *arena)
+{
+    return arena->peak;
+}
+
+cl_int ReleaseArena(HostArena *arena)
+{
+    if (arena->base && munmap(arena->base, arena->capacity) != 0)
+        return CL_INVALID_VALUE;
+
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->offset = 0;
+
+    return CL_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#define ARENA_DEFAULT_ALIGNMENT 64 // Cache line; also satisfies CL_DEVICE_MEM_BASE_ADDR_ALIGN on most devices.
+
+/**
+ * @brief Bump allocator for host buffers.
+ * The arena reserves its whole capacity up front; pages are only committed as they are touched.
+ * Allocations are never freed individually.  ResetArena releases all of them at once.
+ */
+typedef struct _HostArena
+{
+    char *base;
+    size_t capacity;
+    size_t offset;
+    size_t peak;
+    bool huge_pages; // True if the arena is backed by (or advised to use) huge pages.
+} HostArena;
+
+/**
+ * @brief A host allocator the Load* functions can draw from instead of malloc.
+ * Data from an allocator belongs to the allocator and must not be passed to FreeMatrix or FreeImg.
+ *
+ * @param bytes The number of bytes to allocate.
+ * @param user_data The allocator's state.
+ *
+ * @return A pointer to the allocation, or NULL on failure.
+ */
+typedef void *(*HostAllocFn)(size_t bytes, void *user_data);
+
+/**
+ * @brief Creates a host arena.
+ * Tries explicit huge pages first, then transparent huge pages, then regular pages.
+ * The caller is responsible for calling ReleaseArena.
+ *
+ * @param capacity The number of bytes to reserve.
+ * @param arena The arena to initialize.
+ *
+ * @return CL_SUCCESS if and only if the address space is reserved.
+ */
+cl_int CreateArena(size_t capacity, HostArena *arena);
+
+/**
+ * @brief Creates a host arena that only reserves address space, for large capacities that are
+ * rarely filled.  Skips explicit huge pages, which would take the whole capacity from the
+ * huge page pool up front; transparent huge pages are still advised.
+ * The caller is responsible for calling ReleaseArena.
+ */
+cl_int CreateReservedArena(size_t capacity, HostArena *arena);
+
+/**
+ * @brief Allocates from a host arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param bytes The number of bytes to allocate.
+ * @param alignment The alignment in bytes.  Must be a power of two.  0 selects ARENA_DEFAULT_ALIGNMENT.
+ *
+ * @return A pointer to the allocation, or NULL if the arena is exhausted.
+ */
+void *AllocFromArena(HostArena *arena, size_t bytes, size_t alignment);
+
+/**
+ * @brief HostAllocFn adapter for AllocFromArena.  user_data is the HostArena.
+ */
+void *ArenaAllocator(size_t bytes, void *arena);
+
+/**
+ * @brief Releases every allocation of an arena at once, e.g. between batches.
+ * Any Matrix or Image loaded from the arena is invalid afterwards.
+ */
+void ResetArena(HostArena *arena);
+
+/**
+ * @brief Returns the largest number of bytes the arena has had in use since it was created.
+ */
+size_t GetArenaPeak(const HostArena *arena);
+
+/**
+ * @brief Unmaps an arena.
+ *
+ * @return CL_SUCCESS if and only if the arena is successfully released.
+ */
+cl_int ReleaseArena(HostArena *arena);
+
+#ifdef __cplusplus
+}
+#endif
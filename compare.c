@@ -0,0 +1,409 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compare.h"
+
+// Summary buffer layout: mismatches, max error, first index.
+#define SUMMARY_WORDS 3
+
+// first_mismatches scans INDEX_RUNS runs of INDEX_RUN_LENGTH elements per launch.  Each run
+// reports its count then up to OCL_COMPARE_MAX_INDICES indices, in ascending order.
+#define INDEX_RUN_LENGTH 256
+#define INDEX_RUNS 256
+#define INDEX_RUN_WORDS (1 + OCL_COMPARE_MAX_INDICES)
+
+// Each work-group reduces its mismatches in local memory and publishes them with one set of
+// global atomics, so a badly wrong result does not serialize on a single counter.
+static const char *compare_source =
+    "__kernel void compare_results(__global const int *truth, __global const int *student,\n"
+    "                              const uint count, __global uint *summary)\n"
+    "{\n"
+    "    __local uint group_mismatches, group_max, group_first;\n"
+    "    uint i = get_global_id(0);\n"
+    "\n"
+    "    if (get_local_id(0) == 0)\n"
+    "    {\n"
+    "        group_mismatches = 0;\n"
+    "        group_max = 0;\n"
+    "        group_first = UINT_MAX;\n"
+    "    }\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "\n"
+    "    if (i < count && truth[i] != student[i])\n"
+    "    {\n"
+    "        atomic_inc(&group_mismatches);\n"
+    "        atomic_max(&group_max, abs_diff(truth[i], student[i]));\n"
+    "        atomic_min(&group_first, i);\n"
+    "    }\n"
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "\n"
+    "    if (get_local_id(0) == 0 && group_mismatches != 0)\n"
+    "    {\n"
+    "        atomic_add(&summary[0], group_mismatches);\n"
+    "        atomic_max(&summary[1], group_max);\n"
+    "        atomic_min(&summary[2], group_first);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "__kernel void first_mismatches(__global const int *truth, __global const int *student,\n"
+    "                               const uint start, const uint count, __global uint *found)\n"
+    "{\n"
+    "    __global uint *run_found = found + get_global_id(0) * (MAX_INDICES + 1);\n"
+    "    uint begin = start + (uint)get_global_id(0) * RUN_LENGTH;\n"
+    "    uint end = count - begin < RUN_LENGTH ? count : begin + RUN_LENGTH;\n"
+    "    uint n = 0;\n"
+    "\n"
+    "    for (uint i = begin; i < end && n < MAX_INDICES; i++)\n"
+    "        if (truth[i] != student[i])\n"
+    "            run_found[1 + n++] = i;\n"
+    "    run_found[0] = n;\n"
+    "}\n";
+
+cl_int OclCreateComparer(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                         OclComparer *comparer)
+{
+    char options[128];
+    cl_int status;
+
+    memset(comparer, 0, sizeof(*comparer));
+    comparer->context = context;
+    comparer->queue = queue;
+
+    cl_program program = clCreateProgramWithSource(context, 1, &compare_source, NULL, &status);
+    if (status != CL_SUCCESS)
+        return status;
+
+    snprintf(options, sizeof(options), "-DMAX_INDICES=%d -DRUN_LENGTH=%d", OCL_COMPARE_MAX_INDICES,
+             INDEX_RUN_LENGTH);
+    status = clBuildProgram(program, 1, &device_id, options, NULL, NULL);
+    if (status != CL_SUCCESS)
+    {
+        clReleaseProgram(program);
+        return status;
+    }
+
+    cl_kernel kernel = clCreateKernel(program, "compare_results", &status);
+    if (status != CL_SUCCESS)
+    {
+        clReleaseProgram(program);
+        return status;
+    }
+
+    cl_kernel index_kernel = clCreateKernel(program, "first_mismatches", &status);
+    if (status != CL_SUCCESS)
+    {
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return status;
+    }
+
+    size_t max_local = 0;
+    if (clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local),
+                                 &max_local, NULL) != CL_SUCCESS || max_local == 0)
+        max_local = 1;
+
+    cl_mem summary = clCreateBuffer(context, CL_MEM_READ_WRITE, SUMMARY_WORDS * sizeof(cl_uint), NULL, &status);
+    cl_mem indices = NULL;
+    if (status == CL_SUCCESS)
+        indices = clCreateBuffer(context, CL_MEM_WRITE_ONLY, INDEX_RUNS * INDEX_RUN_WORDS * sizeof(cl_uint),
+                                 NULL, &status);
+    if (status != CL_SUCCESS)
+    {
+        if (summary)
+            clReleaseMemObject(summary);
+        clReleaseKernel(index_kernel);
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+        return status;
+    }
+
+    comparer->program = program;
+    comparer->kernel = kernel;
+    comparer->index_kernel = index_kernel;
+    comparer->summary = summary;
+    comparer->indices = indices;
+    comparer->local_size = max_local < OCL_COMPARE_WORK_GROUP ? max_local : OCL_COMPARE_WORK_GROUP;
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Fills summary->indices with the lowest mismatching indices.
+ * Scans forward from summary->first one launch at a time and stops as soon as it has
+ * OCL_COMPARE_MAX_INDICES of them, or all of them.
+ */
+static cl_int CollectIndices(OclComparer *comparer, cl_mem truth, cl_mem student, cl_uint count,
+                             OclCompareSummary *summary)
+{
+    cl_uint found[INDEX_RUNS * INDEX_RUN_WORDS];
+    cl_uint wanted = summary->mismatches < OCL_COMPARE_MAX_INDICES ? summary->mismatches : OCL_COMPARE_MAX_INDICES;
+    cl_uint start = summary->first;
+    cl_int status = CL_SUCCESS;
+
+    summary->num_indices = 0;
+    while (summary->num_indices < wanted && start < count)
+    {
+        size_t runs = (count - start + (size_t)INDEX_RUN_LENGTH - 1) / INDEX_RUN_LENGTH;
+        if (runs > INDEX_RUNS)
+            runs = INDEX_RUNS;
+
+        status = clSetKernelArg(comparer->index_kernel, 0, sizeof(cl_mem), &truth);
+        if (status == CL_SUCCESS)
+            status = clSetKernelArg(comparer->index_kernel, 1, sizeof(cl_mem), &student);
+        if (status == CL_SUCCESS)
+            status = clSetKernelArg(comparer->index_kernel, 2, sizeof(cl_uint), &start);
+        if (status == CL_SUCCESS)
+            status = clSetKernelArg(comparer->index_kernel, 3, sizeof(cl_uint), &count);
+        if (status == CL_SUCCESS)
+            status = clSetKernelArg(comparer->index_kernel, 4, sizeof(cl_mem), &comparer->indices);
+        if (status == CL_SUCCESS)
+            status = clEnqueueNDRangeKernel(comparer->queue, comparer->index_kernel, 1, NULL, &runs,
+                                            NULL, 0, NULL, NULL);
+        if (status == CL_SUCCESS)
+            status = clEnqueueReadBuffer(comparer->queue, comparer->indices, CL_TRUE, 0,
+                                         runs * INDEX_RUN_WORDS * sizeof(cl_uint), found, 0, NULL, NULL);
+        if (status != CL_SUCCESS)
+            return status;
+
+        // Runs are in index order, so taking them in turn keeps the indices ascending.
+        for (size_t r = 0; r < runs && summary->num_indices < wanted; r++)
+        {
+            const cl_uint *run = found + r * INDEX_RUN_WORDS;
+            for (cl_uint j = 0; j < run[0] && summary->num_indices < wanted; j++)
+                summary->indices[summary->num_indices++] = run[1 + j];
+        }
+
+        if (count - start <= runs * INDEX_RUN_LENGTH)
+            break;
+        start += (cl_uint)(runs * INDEX_RUN_LENGTH);
+    }
+
+    return status;
+}
+
+cl_int OclCompareBuffers(OclComparer *comparer, cl_mem truth, cl_mem student, size_t count,
+                         OclCompareSummary *summary)
+{
+    cl_uint words[SUMMARY_WORDS] = {0, 0, UINT_MAX};
+    cl_int status;
+
+    if (!comparer->kernel)
+        return CL_INVALID_KERNEL;
+    if (count > UINT_MAX)
+        return CL_INVALID_VALUE; // The kernel indexes with uint
+
+    memset(summary, 0, sizeof(*summary));
+    if (count == 0)
+        return CL_SUCCESS;
+
+    cl_uint n = (cl_uint)count;
+    size_t local_size = comparer->local_size;
+    size_t global_size = (count + local_size - 1) / local_size * local_size;
+
+    status = clEnqueueWriteBuffer(comparer->queue, comparer->summary, CL_TRUE, 0, sizeof(words),
+                                  words, 0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = clSetKernelArg(comparer->kernel, 0, sizeof(cl_mem), &truth);
+    if (status == CL_SUCCESS)
+        status = clSetKernelArg(comparer->kernel, 1, sizeof(cl_mem), &student);
+    if (status == CL_SUCCESS)
+        status = clSetKernelArg(comparer->kernel, 2, sizeof(cl_uint), &n);
+    if (status == CL_SUCCESS)
+        status = clSetKernelArg(comparer->kernel, 3, sizeof(cl_mem), &comparer->summary);
+    if (status == CL_SUCCESS)
+        status = clEnqueueNDRangeKernel(comparer->queue, comparer->kernel, 1, NULL, &global_size,
+                                        &local_size, 0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = clEnqueueReadBuffer(comparer->queue, comparer->summary, CL_TRUE, 0, sizeof(words),
+                                     words, 0, NULL, NULL);
+    if (status != CL_SUCCESS)
+        return status;
+
+    summary->mismatches = words[0];
+    summary->max_error = words[1];
+    summary->first = words[2];
+
+    if (summary->mismatches == 0)
+        return CL_SUCCESS;
+
+    status = CollectIndices(comparer, truth, student, n, summary);
+    if (status != CL_SUCCESS)
+        return status;
+
+    // The values at the first mismatch, for CheckImg's message.
+    size_t offset = (size_t)summary->first * sizeof(cl_int);
+    status = clEnqueueReadBuffer(comparer->queue, truth, CL_TRUE, offset, sizeof(cl_int),
+                                 &summary->expected, 0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = clEnqueueReadBuffer(comparer->queue, student, CL_TRUE, offset, sizeof(cl_int),
+                                     &summary->found, 0, NULL, NULL);
+
+    return status;
+}
+
+/**
+ * @brief Runs the device compare, uploading the truth first if it is not resident.
+ */
+static cl_int CompareOnDevice(OclComparer *comparer, int *truth_data, cl_mem truth_buffer,
+                              cl_mem student_buffer, size_t count, OclCompareSummary *summary)
+{
+    cl_mem uploaded = NULL;
+    cl_int status;
+
+    if (!comparer->kernel)
+        return CL_INVALID_KERNEL;
+
+    if (!truth_buffer)
+    {
+        uploaded = clCreateBuffer(comparer->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                  count * sizeof(int), truth_data, &status);
+        if (status != CL_SUCCESS)
+            return status;
+        truth_buffer = uploaded;
+    }
+
+    status = OclCompareBuffers(comparer, truth_buffer, student_buffer, count, summary);
+
+    if (uploaded)
+        clReleaseMemObject(uploaded);
+
+    return status;
+}
+
+/**
+ * @brief Reads a result back for the host checkers.
+ */
+static int *ReadBack(OclComparer *comparer, cl_mem student_buffer, size_t count)
+{
+    int *data = (int *)malloc((count ? count : 1) * sizeof(int));
+    if (!data)
+        return NULL;
+
+    if (clEnqueueReadBuffer(comparer->queue, student_buffer, CL_TRUE, 0, count * sizeof(int), data,
+                            0, NULL, NULL) != CL_SUCCESS)
+    {
+        free(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+/**
+ * @brief Fills a summary on the host, for callers that asked for one on the fallback path.
+ */
+static void CompareOnHost(const int *truth, const int *student, size_t count, OclCompareSummary *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    for (size_t i = 0; i < count; i++)
+    {
+        if (truth[i] == student[i])
+            continue;
+
+        cl_uint error = truth[i] > student[i] ? (cl_uint)truth[i] - (cl_uint)student[i]
+                                              : (cl_uint)student[i] - (cl_uint)truth[i];
+        if (summary->mismatches == 0)
+        {
+            summary->first = (cl_uint)i;
+            summary->expected = truth[i];
+            summary->found = student[i];
+        }
+        if (summary->num_indices < OCL_COMPARE_MAX_INDICES)
+            summary->indices[summary->num_indices++] = (cl_uint)i;
+        if (error > summary->max_error)
+            summary->max_error = error;
+        summary->mismatches++;
+    }
+}
+
+cl_int OclCheckMatrix(OclComparer *comparer, Matrix *truth, cl_mem truth_buffer, cl_mem student_buffer,
+                      const unsigned int shape[2], OclCompareSummary *summary)
+{
+    OclCompareSummary local;
+    if (!summary)
+        summary = &local;
+
+    if (truth->shape[0] != shape[0] || truth->shape[1] != shape[1])
+    {
+        printf("!!INCORRECT SHAPE!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    size_t count = (size_t)shape[0] * shape[1];
+    if (CompareOnDevice(comparer, truth->data, truth_buffer, student_buffer, count, summary) == CL_SUCCESS)
+    {
+        if (summary->mismatches != 0)
+        {
+            printf("!!SOLUTION IS NOT CORRECT!!\n");
+            return CL_INVALID_VALUE;
+        }
+
+        printf("!!SOLUTION IS CORRECT!!\n");
+        return CL_SUCCESS;
+    }
+
+    Matrix student = {ReadBack(comparer, student_buffer, count), {shape[0], shape[1]}};
+    if (!student.data)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    CompareOnHost(truth->data, student.data, count, summary);
+    cl_int status = CheckMatrix(truth, &student);
+    free(student.data);
+
+    return status;
+}
+
+cl_int OclCheckImg(OclComparer *comparer, Image *truth, cl_mem truth_buffer, cl_mem student_buffer,
+                   const unsigned int shape[2], OclCompareSummary *summary)
+{
+    OclCompareSummary local;
+    if (!summary)
+        summary = &local;
+
+    if (truth->shape[0] != shape[0] || truth->shape[1] != shape[1])
+    {
+        printf("!!SOLUTION IS NOT CORRECT!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    size_t count = (size_t)shape[0] * shape[1] * IMAGE_CHANNELS;
+    if (CompareOnDevice(comparer, truth->data, truth_buffer, student_buffer, count, summary) == CL_SUCCESS)
+    {
+        if (summary->mismatches != 0)
+        {
+            printf("!!SOLUTION IS NOT CORRECT!! Expected: %d, Found %df at %d\n", summary->expected,
+                   summary->found, (int)summary->first);
+            return CL_INVALID_VALUE;
+        }
+
+        printf("!!SOLUTION IS CORRECT!!\n");
+        return CL_SUCCESS;
+    }
+
+    Image student = {ReadBack(comparer, student_buffer, count), {shape[0], shape[1], IMAGE_CHANNELS}};
+    if (!student.data)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    CompareOnHost(truth->data, student.data, count, summary);
+    cl_int status = CheckImg(truth, &student);
+    free(student.data);
+
+    return status;
+}
+
+void OclReleaseComparer(OclComparer *comparer)
+{
+    if (comparer->summary)
+        clReleaseMemObject(comparer->summary);
+    if (comparer->indices)
+        clReleaseMemObject(comparer->indices);
+    if (comparer->index_kernel)
+        clReleaseKernel(comparer->index_kernel);
+    if (comparer->kernel)
+        clReleaseKernel(comparer->kernel);
+    if (comparer->program)
+        clReleaseProgram(comparer->program);
+    memset(comparer, 0, sizeof(*comparer));
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#include "img.h"
+#include "matrix.h"
+
+#define OCL_COMPARE_MAX_INDICES 8
+#define OCL_COMPARE_WORK_GROUP 64
+
+/**
+ * @brief Summary of an element-wise comparison of two int buffers.
+ */
+typedef struct _OclCompareSummary
+{
+    cl_uint mismatches;
+    cl_uint max_error;   // Largest |expected - found|.
+    cl_uint first;       // Lowest mismatching index.  Only valid if mismatches > 0.
+    cl_int expected;     // Expected value at first.
+    cl_int found;        // Found value at first.
+    cl_uint num_indices;
+    cl_uint indices[OCL_COMPARE_MAX_INDICES]; // The first mismatching indices, in ascending order.
+} OclCompareSummary;
+
+/**
+ * @brief The built compare kernels and their output buffers.  Reuse one across checks.
+ */
+typedef struct _OclComparer
+{
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;       // compare_results: counts, max error and first index.
+    cl_kernel index_kernel; // first_mismatches: the indices after first.
+    cl_mem summary;
+    cl_mem indices;
+    size_t local_size;
+} OclComparer;
+
+/**
+ * @brief Builds the embedded compare kernels for a device.
+ *
+ * @return CL_SUCCESS if and only if the kernels were built.  On failure the comparer keeps the
+ *         context and queue, so the checks below still work through the host checkers.
+ */
+cl_int OclCreateComparer(cl_context context, cl_device_id device_id, cl_command_queue queue,
+                         OclComparer *comparer);
+
+/**
+ * @brief Compares count ints of two device buffers on the device and reads back only the summary.
+ * The indices come from a second pass that scans forward from the first mismatch and stops
+ * once it has found OCL_COMPARE_MAX_INDICES of them.
+ */
+cl_int OclCompareBuffers(OclComparer *comparer, cl_mem truth, cl_mem student, size_t count,
+                         OclCompareSummary *summary);
+
+/**
+ * @brief CheckMatrix against a result still on the device.
+ * Falls back to reading the result back and calling CheckMatrix if the compare kernel
+ * was not built or the device compare fails.
+ *
+ * @param truth_buffer truth->data already resident on the device, or NULL to upload it.
+ * @param shape The result's shape.
+ * @param summary Optional.  Filled in by either path.
+ */
+cl_int OclCheckMatrix(OclComparer *comparer, Matrix *truth, cl_mem truth_buffer, cl_mem student_buffer,
+                      const unsigned int shape[2], OclCompareSummary *summary);
+
+/**
+ * @brief CheckImg against a result still on the device.  Same fallback as OclCheckMatrix.
+ */
+cl_int OclCheckImg(OclComparer *comparer, Image *truth, cl_mem truth_buffer, cl_mem student_buffer,
+                   const unsigned int shape[2], OclCompareSummary *summary);
+
+/**
+ * @brief Releases a comparer.
+ */
+void OclReleaseComparer(OclComparer *comparer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -212,6 +212,10 @@ cl_int OclFindDevices(const cl_platform_id platform_id, const OclDeviceProp **de
                             (const void **)&temp_devices[i].global_mem_size);
         if (status != CL_SUCCESS)
             return status;
+        status = OclGetInfo(device_ids[i], CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+                            (const void **)&temp_devices[i].max_mem_alloc_size);
+        if (status != CL_SUCCESS)
+            return status;
         status = OclGetInfo(device_ids[i], CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE,
                             (const void **)&temp_devices[i].max_constant_buffer_size);
         if (status != CL_SUCCESS)
@@ -232,6 +236,21 @@ cl_int OclFindDevices(const cl_platform_id platform_id, const OclDeviceProp **de
                             (const void **)&temp_devices[i].max_work_item_dimensions);
         if (status != CL_SUCCESS)
             return status;
+#ifdef CL_VERSION_2_0
+        status = OclGetInfo(device_ids[i], CL_DEVICE_SVM_CAPABILITIES,
+                            (const void **)&temp_devices[i].svm_capabilities);
+#else
+        status = CL_INVALID_VALUE;
+#endif
+        if (status == CL_INVALID_VALUE)
+        {
+            // OpenCL 1.x devices do not know the query; they have no SVM.
+            temp_devices[i].svm_capabilities =
+                (cl_device_svm_capabilities *)calloc(1, sizeof(cl_device_svm_capabilities));
+            status = temp_devices[i].svm_capabilities ? CL_SUCCESS : CL_OUT_OF_HOST_MEMORY;
+        }
+        if (status != CL_SUCCESS)
+            return status;
     }
 
     *devices = temp_devices;
@@ -306,16 +325,29 @@ cl_int OclFindPlatforms(const OclPlatformProp **platforms, cl_uint *num_platform
     return CL_SUCCESS;
 }
 
+cl_command_queue OclCreateCommandQueue(cl_context context, cl_device_id device_id,
+                                       cl_command_queue_properties properties, cl_int *status)
+{
+#ifdef CL_VERSION_2_0
+    cl_queue_properties list[] = {CL_QUEUE_PROPERTIES, properties, 0};
+    return clCreateCommandQueueWithProperties(context, device_id, properties ? list : NULL, status);
+#else
+    return clCreateCommandQueue(context, device_id, properties, status);
+#endif
+}
+
 cl_int OclFreeDeviceProp(OclDeviceProp *device)
 {
     free(device->name);
     free(device->max_compute_units);
     free(device->global_mem_size);
+    free(device->max_mem_alloc_size);
     free(device->max_constant_buffer_size);
     free(device->local_mem_size);
     free(device->max_work_item_sizes);
     free(device->max_work_group_size);
     free(device->max_work_item_dimensions);
+    free(device->svm_capabilities);
 
     return CL_SUCCESS;
 }
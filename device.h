@@ -16,6 +16,10 @@ extern "C" {
 #include <CL/cl.h>
 #endif
 
+#ifndef CL_VERSION_2_0 // e.g. Apple's OpenCL 1.2 framework, which has no SVM.
+typedef cl_bitfield cl_device_svm_capabilities;
+#endif
+
 #ifndef OCL_DEVICE_TYPE // Allows us to override in the Makefile.
 #define OCL_DEVICE_TYPE CL_DEVICE_TYPE_GPU
 #endif
@@ -31,11 +35,13 @@ typedef struct _OclDeviceProp
     cl_device_type *type;
     cl_uint *max_compute_units;
     cl_ulong *global_mem_size;
+    cl_ulong *max_mem_alloc_size;
     cl_ulong *max_constant_buffer_size;
     cl_ulong *local_mem_size;
     size_t *max_work_item_sizes;
     size_t *max_work_group_size;
     cl_uint *max_work_item_dimensions;
+    cl_device_svm_capabilities *svm_capabilities; // 0 on devices older than OpenCL 2.0.
     cl_device_id device_id;
 } OclDeviceProp;
 
@@ -105,6 +111,19 @@ cl_int OclFindPlatforms(const OclPlatformProp **platforms, cl_uint *num_platform
 cl_int OclFindDevices(const cl_platform_id platform_id, const OclDeviceProp **devices,
                       cl_uint *num_devices);
 
+/**
+ * @brief Creates a command queue.
+ * Uses clCreateCommandQueueWithProperties with OpenCL 2.0+ headers, and clCreateCommandQueue
+ * with older ones such as Apple's OpenCL 1.2 framework.
+ *
+ * @param properties CL_QUEUE_* flags, or 0 for an in-order queue without profiling.
+ * @param status Receives the creation status.
+ *
+ * @return The queue, or NULL on failure.
+ */
+cl_command_queue OclCreateCommandQueue(cl_context context, cl_device_id device_id,
+                                       cl_command_queue_properties properties, cl_int *status);
+
 /**
  * @brief Converts cl_device_type to human-readable string,
  *
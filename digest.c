@@ -0,0 +1,500 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "digest.h"
+
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME32_4 0x27D4EB2FU
+#define XXH_PRIME32_5 0x165667B1U
+
+static uint32_t Rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static uint32_t Read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t XxhRound(uint32_t acc, uint32_t input)
+{
+    acc += input * XXH_PRIME32_2;
+    acc = Rotl32(acc, 13);
+    return acc * XXH_PRIME32_1;
+}
+
+uint32_t DigestHash(const void *data, size_t size, uint32_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + size;
+    uint32_t h32;
+
+    if (size >= 16)
+    {
+        const unsigned char *limit = end - 16;
+        uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = seed + XXH_PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_PRIME32_1;
+
+        do
+        {
+            v1 = XxhRound(v1, Read32(p));
+            v2 = XxhRound(v2, Read32(p + 4));
+            v3 = XxhRound(v3, Read32(p + 8));
+            v4 = XxhRound(v4, Read32(p + 12));
+            p += 16;
+        } while (p <= limit);
+
+        h32 = Rotl32(v1, 1) + Rotl32(v2, 7) + Rotl32(v3, 12) + Rotl32(v4, 18);
+    }
+    else
+    {
+        h32 = seed + XXH_PRIME32_5;
+    }
+
+    h32 += (uint32_t)size;
+
+    for (; p + 4 <= end; p += 4)
+    {
+        h32 += Read32(p) * XXH_PRIME32_3;
+        h32 = Rotl32(h32, 17) * XXH_PRIME32_4;
+    }
+    for (; p < end; p++)
+    {
+        h32 += (*p) * XXH_PRIME32_5;
+        h32 = Rotl32(h32, 11) * XXH_PRIME32_1;
+    }
+
+    h32 ^= h32 >> 15;
+    h32 *= XXH_PRIME32_2;
+    h32 ^= h32 >> 13;
+    h32 *= XXH_PRIME32_3;
+    h32 ^= h32 >> 16;
+
+    return h32;
+}
+
+/**
+ * @brief Allocates a digest's checksum array for the given shape.
+ */
+static cl_int AllocDigest(const unsigned int shape[3], unsigned int block_rows, Digest *digest)
+{
+    if (block_rows == 0)
+        block_rows = DIGEST_DEFAULT_BLOCK_ROWS;
+
+    digest->shape[0] = shape[0];
+    digest->shape[1] = shape[1];
+    digest->shape[2] = shape[2] ? shape[2] : 1;
+    digest->block_rows = block_rows;
+    digest->num_blocks = (shape[0] + block_rows - 1) / block_rows;
+    digest->hashes = (uint32_t *)malloc((digest->num_blocks ? digest->num_blocks : 1) * sizeof(uint32_t));
+
+    return digest->hashes ? CL_SUCCESS : CL_OUT_OF_HOST_MEMORY;
+}
+
+/**
+ * @brief Rows in block b of a digest.
+ */
+static unsigned int DigestBlockRows(const Digest *digest, unsigned int b)
+{
+    unsigned int first = b * digest->block_rows;
+    return first + digest->block_rows > digest->shape[0] ? digest->shape[0] - first : digest->block_rows;
+}
+
+cl_int ComputeDigest(const int *data, const unsigned int shape[3], unsigned int block_rows,
+                     Digest *digest)
+{
+    cl_int status = AllocDigest(shape, block_rows, digest);
+    if (status != CL_SUCCESS)
+        return status;
+
+    size_t row_elems = (size_t)digest->shape[1] * digest->shape[2];
+    for (unsigned int b = 0; b < digest->num_blocks; b++)
+    {
+        const int *block = data + (size_t)b * digest->block_rows * row_elems;
+        digest->hashes[b] = DigestHash(block, DigestBlockRows(digest, b) * row_elems * sizeof(int), 0);
+    }
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Opens a matrix ("# (rows, cols)") or raw image ("# (rows, cols, channels)") file
+ * and parses its header, leaving the file positioned at the first value.
+ */
+static FILE *OpenExpected(const char *path, unsigned int shape[3])
+{
+    char header[128];
+    FILE *data_file = fopen(path, "r");
+    if (!data_file) // Error opening file
+        return NULL;
+
+    shape[0] = shape[1] = 0;
+    shape[2] = 1;
+    if (!fgets(header, sizeof(header), data_file) ||
+        sscanf(header, "# (%u, %u, %u)", &shape[0], &shape[1], &shape[2]) < 2)
+    {
+        fclose(data_file);
+        return NULL;
+    }
+
+    // Same defaults as LoadMatrix and LoadImgRaw.
+    if (shape[0] == 0)
+        shape[0] = 1;
+    if (shape[1] == 0)
+        shape[1] = 1;
+    if (shape[2] == 0)
+        shape[2] = IMAGE_CHANNELS;
+
+    return data_file;
+}
+
+/**
+ * @brief Reads the next count values of an expected file.  Missing values read as 0, as with LoadMatrix.
+ */
+static void ReadExpected(FILE *data_file, int *values, size_t count)
+{
+    size_t n = 0;
+    while (n < count && fscanf(data_file, "%d", &values[n]) == 1)
+        n++;
+    memset(values + n, 0, (count - n) * sizeof(int));
+}
+
+cl_int CreateDigest(const char *expected_path, const char *digest_path, unsigned int block_rows)
+{
+    unsigned int shape[3];
+    Digest digest;
+    cl_int status;
+
+    FILE *data_file = OpenExpected(expected_path, shape);
+    if (!data_file)
+        return CL_INVALID_VALUE;
+
+    status = AllocDigest(shape, block_rows, &digest);
+    size_t row_elems = (size_t)digest.shape[1] * digest.shape[2];
+    int *block = status == CL_SUCCESS ? (int *)malloc(digest.block_rows * row_elems * sizeof(int)) : NULL;
+    if (!block)
+    {
+        FreeDigest(&digest);
+        fclose(data_file);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    for (unsigned int b = 0; b < digest.num_blocks; b++)
+    {
+        size_t count = DigestBlockRows(&digest, b) * row_elems;
+        ReadExpected(data_file, block, count);
+        digest.hashes[b] = DigestHash(block, count * sizeof(int), 0);
+    }
+
+    free(block);
+    fclose(data_file);
+
+    status = SaveDigest(digest_path, &digest);
+    FreeDigest(&digest);
+
+    return status;
+}
+
+cl_int SaveDigest(const char *path, const Digest *digest)
+{
+    uint32_t header[5] = {digest->shape[0], digest->shape[1], digest->shape[2],
+                          digest->block_rows, digest->num_blocks};
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) // Error opening file
+        return CL_INVALID_VALUE;
+
+    int failed = fwrite(DIGEST_MAGIC, 1, 4, fp) != 4 ||
+                 fwrite(header, sizeof(uint32_t), 5, fp) != 5 ||
+                 fwrite(digest->hashes, sizeof(uint32_t), digest->num_blocks, fp) != digest->num_blocks;
+    fclose(fp);
+
+    return failed ? CL_INVALID_VALUE : CL_SUCCESS;
+}
+
+cl_int LoadDigest(const char *path, Digest *digest)
+{
+    char magic[4];
+    uint32_t header[5];
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) // Error opening file
+        return CL_INVALID_VALUE;
+
+    if (fread(magic, 1, 4, fp) != 4 || memcmp(magic, DIGEST_MAGIC, 4) != 0 ||
+        fread(header, sizeof(uint32_t), 5, fp) != 5 || header[3] == 0)
+    {
+        fclose(fp);
+        return CL_INVALID_VALUE;
+    }
+
+    cl_int status = AllocDigest(header, header[3], digest);
+    if (status == CL_SUCCESS && digest->num_blocks != header[4])
+        status = CL_INVALID_VALUE;
+    if (status == CL_SUCCESS &&
+        fread(digest->hashes, sizeof(uint32_t), digest->num_blocks, fp) != digest->num_blocks)
+        status = CL_INVALID_VALUE;
+    fclose(fp);
+
+    if (status != CL_SUCCESS)
+        FreeDigest(digest);
+
+    return status;
+}
+
+void FreeDigest(Digest *digest)
+{
+    free(digest->hashes);
+    digest->hashes = NULL;
+}
+
+/**
+ * @brief Releases a check's buffers.
+ */
+static void EndDigestCheck(DigestCheck *check)
+{
+    unsigned int kept = check->num_mismatched < DIGEST_MAX_KEPT ? check->num_mismatched : DIGEST_MAX_KEPT;
+    for (unsigned int i = 0; i < kept; i++)
+        free(check->mismatched_data[i]);
+    free(check->block);
+    check->block = NULL;
+    check->num_mismatched = 0;
+}
+
+/**
+ * @brief Prints the shape verdict of CheckImg for image digests and of CheckMatrix otherwise.
+ */
+static void PrintShapeMismatch(const Digest *digest)
+{
+    if (digest->shape[2] > 1)
+        printf("!!SOLUTION IS NOT CORRECT!!\n");
+    else
+        printf("!!INCORRECT SHAPE!!\n");
+}
+
+cl_int BeginDigestCheck(const Digest *digest, DigestCheck *check)
+{
+    memset(check, 0, sizeof(*check));
+    check->digest = digest;
+    check->row_elems = (size_t)digest->shape[1] * digest->shape[2];
+
+    check->block = (int *)malloc(digest->block_rows * check->row_elems * sizeof(int));
+    if (!check->block)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Hashes the staged block.  If its checksum differs, counts it and keeps a copy of it
+ * while fewer than DIGEST_MAX_KEPT blocks are kept.
+ */
+static cl_int CloseDigestBlock(DigestCheck *check)
+{
+    const Digest *digest = check->digest;
+    unsigned int b = (check->rows_seen - 1) / digest->block_rows;
+    size_t bytes = check->block_fill * check->row_elems * sizeof(int);
+
+    check->block_fill = 0;
+    if (DigestHash(check->block, bytes, 0) == digest->hashes[b])
+        return CL_SUCCESS;
+
+    if (check->num_mismatched < DIGEST_MAX_KEPT)
+    {
+        int *copy = (int *)malloc(bytes);
+        if (!copy)
+            return CL_OUT_OF_HOST_MEMORY;
+        memcpy(copy, check->block, bytes);
+        check->mismatched[check->num_mismatched] = b;
+        check->mismatched_data[check->num_mismatched] = copy;
+    }
+    check->num_mismatched++;
+
+    return CL_SUCCESS;
+}
+
+cl_int UpdateDigestCheck(DigestCheck *check, const int *rows, unsigned int num_rows)
+{
+    const Digest *digest = check->digest;
+    cl_int status = CL_SUCCESS;
+
+    if (check->rows_seen + num_rows > digest->shape[0])
+        return CL_INVALID_VALUE; // More rows than the expected output
+
+    for (unsigned int r = 0; r < num_rows && status == CL_SUCCESS; r++)
+    {
+        memcpy(check->block + check->block_fill * check->row_elems,
+               rows + r * check->row_elems, check->row_elems * sizeof(int));
+        check->block_fill++;
+        check->rows_seen++;
+
+        if (check->block_fill == digest->block_rows || check->rows_seen == digest->shape[0])
+            status = CloseDigestBlock(check);
+    }
+
+    return status;
+}
+
+cl_int FinishDigestCheck(DigestCheck *check, const char *expected_path)
+{
+    const Digest *digest = check->digest;
+    unsigned int shape[3];
+    cl_int status = CL_SUCCESS;
+
+    if (check->rows_seen != digest->shape[0])
+    {
+        EndDigestCheck(check);
+        PrintShapeMismatch(digest);
+        return CL_INVALID_VALUE;
+    }
+
+    if (check->num_mismatched == 0)
+    {
+        EndDigestCheck(check);
+        printf("!!SOLUTION IS CORRECT!!\n");
+        return CL_SUCCESS;
+    }
+
+    FILE *data_file = OpenExpected(expected_path, shape);
+    if (!data_file)
+    {
+        EndDigestCheck(check);
+        printf("!!SOLUTION IS NOT CORRECT!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    // Walk the expected file once, only comparing the kept blocks.
+    unsigned int kept = check->num_mismatched < DIGEST_MAX_KEPT ? check->num_mismatched : DIGEST_MAX_KEPT;
+    size_t block_elems = digest->block_rows * check->row_elems;
+    unsigned int next = 0;
+    for (unsigned int b = 0; b < digest->num_blocks && next < kept; b++)
+    {
+        size_t count = DigestBlockRows(digest, b) * check->row_elems;
+        ReadExpected(data_file, check->block, count);
+        if (check->mismatched[next] != b)
+            continue;
+
+        const int *found = check->mismatched_data[next++];
+        for (size_t i = 0; i < count; i++)
+        {
+            if (check->block[i] != found[i])
+            {
+                if (digest->shape[2] > 1)
+                    printf("!!SOLUTION IS NOT CORRECT!! Expected: %d, Found %df at %d\n",
+                           check->block[i], found[i], (int)(b * block_elems + i));
+                else
+                    printf("!!SOLUTION IS NOT CORRECT!!\n");
+                status = CL_INVALID_VALUE;
+                break;
+            }
+        }
+        if (status != CL_SUCCESS)
+            break;
+    }
+    fclose(data_file);
+
+    EndDigestCheck(check);
+
+    if (status == CL_SUCCESS)
+    {
+        // The kept blocks match the expected file, so the digest no longer describes it and
+        // nothing it says about the other blocks can be trusted either.
+        fprintf(stderr, "Digest is out of date with '%s'; regenerate the digest.\n", expected_path);
+        return CL_INVALID_VALUE;
+    }
+
+    return status;
+}
+
+/**
+ * @brief Checks data already in host memory against a digest file.
+ */
+static cl_int CheckDigest(const char *digest_path, const char *expected_path, const int *data,
+                          const unsigned int shape[3])
+{
+    Digest digest;
+    DigestCheck check;
+    cl_int status;
+
+    status = LoadDigest(digest_path, &digest);
+    if (status != CL_SUCCESS)
+        return status;
+
+    if (digest.shape[0] != shape[0] || digest.shape[1] != shape[1] || digest.shape[2] != shape[2])
+    {
+        PrintShapeMismatch(&digest);
+        FreeDigest(&digest);
+        return CL_INVALID_VALUE;
+    }
+
+    status = BeginDigestCheck(&digest, &check);
+    if (status == CL_SUCCESS)
+        status = UpdateDigestCheck(&check, data, shape[0]);
+    if (status == CL_SUCCESS)
+        status = FinishDigestCheck(&check, expected_path);
+    else
+        EndDigestCheck(&check);
+
+    FreeDigest(&digest);
+    return status;
+}
+
+cl_int CheckMatrixDigest(const char *digest_path, const char *expected_path, Matrix *student)
+{
+    unsigned int shape[3] = {student->shape[0], student->shape[1], 1};
+    return CheckDigest(digest_path, expected_path, student->data, shape);
+}
+
+cl_int CheckImgDigest(const char *digest_path, const char *expected_path, Image *student)
+{
+    unsigned int shape[3] = {student->shape[0], student->shape[1], IMAGE_CHANNELS};
+    return CheckDigest(digest_path, expected_path, student->data, shape);
+}
+
+cl_int OclCheckBufferDigest(cl_command_queue queue, cl_mem buffer, const char *digest_path,
+                            const char *expected_path)
+{
+    Digest digest;
+    DigestCheck check;
+    cl_int status;
+
+    status = LoadDigest(digest_path, &digest);
+    if (status != CL_SUCCESS)
+        return status;
+
+    status = BeginDigestCheck(&digest, &check);
+    int *staging = NULL;
+    size_t block_bytes = digest.block_rows * check.row_elems * sizeof(int);
+    if (status == CL_SUCCESS)
+    {
+        staging = (int *)malloc(block_bytes);
+        if (!staging)
+            status = CL_OUT_OF_HOST_MEMORY;
+    }
+
+    for (unsigned int b = 0; b < digest.num_blocks && status == CL_SUCCESS; b++)
+    {
+        unsigned int rows = DigestBlockRows(&digest, b);
+        status = clEnqueueReadBuffer(queue, buffer, CL_TRUE, b * block_bytes,
+                                     rows * check.row_elems * sizeof(int), staging, 0, NULL, NULL);
+        if (status == CL_SUCCESS)
+            status = UpdateDigestCheck(&check, staging, rows);
+    }
+    free(staging);
+
+    if (status == CL_SUCCESS)
+        status = FinishDigestCheck(&check, expected_path);
+    else
+        EndDigestCheck(&check);
+
+    FreeDigest(&digest);
+    return status;
+}
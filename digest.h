@@ -0,0 +1,117 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#include "img.h"
+#include "matrix.h"
+
+#define DIGEST_MAGIC "HLD1"
+#define DIGEST_DEFAULT_BLOCK_ROWS 64
+#define DIGEST_MAX_KEPT 4 // Mismatching blocks kept to locate the first mismatch.
+
+/**
+ * @brief Per-block checksums of an expected output.
+ * Each block of block_rows rows (the last one may be shorter) is hashed with XXH32 over
+ * its int values in host byte order.
+ */
+typedef struct _Digest
+{
+    unsigned int shape[3]; // rows, cols, channels (1 for matrices).
+    unsigned int block_rows;
+    unsigned int num_blocks;
+    uint32_t *hashes;
+} Digest;
+
+/**
+ * @brief State for checking a result against a digest as its rows arrive.
+ * Only one block of the result is buffered, plus copies of the first DIGEST_MAX_KEPT blocks
+ * whose checksum differs.  Later mismatching blocks are only counted.
+ */
+typedef struct _DigestCheck
+{
+    const Digest *digest;
+    size_t row_elems;
+    unsigned int rows_seen;
+    unsigned int block_fill;
+    int *block;
+    unsigned int num_mismatched;                  // Blocks whose checksum differs.
+    unsigned int mismatched[DIGEST_MAX_KEPT];     // Indices of the first of those blocks.
+    int *mismatched_data[DIGEST_MAX_KEPT];        // The result's values for those blocks.
+} DigestCheck;
+
+/**
+ * @brief XXH32 of a byte range.
+ */
+uint32_t DigestHash(const void *data, size_t size, uint32_t seed);
+
+/**
+ * @brief Computes the digest of data already in memory.
+ * The caller is responsible for calling FreeDigest.
+ */
+cl_int ComputeDigest(const int *data, const unsigned int shape[3], unsigned int block_rows,
+                     Digest *digest);
+
+/**
+ * @brief Computes the digest of an expected matrix or raw image file one block at a time
+ * and saves it to digest_path.  The file itself is never fully loaded.
+ *
+ * @param block_rows Rows per block.  0 selects DIGEST_DEFAULT_BLOCK_ROWS.
+ */
+cl_int CreateDigest(const char *expected_path, const char *digest_path, unsigned int block_rows);
+
+cl_int SaveDigest(const char *path, const Digest *digest);
+cl_int LoadDigest(const char *path, Digest *digest);
+void FreeDigest(Digest *digest);
+
+/**
+ * @brief Starts checking a result against a digest.
+ */
+cl_int BeginDigestCheck(const Digest *digest, DigestCheck *check);
+
+/**
+ * @brief Feeds the next num_rows rows of the result, in order.
+ */
+cl_int UpdateDigestCheck(DigestCheck *check, const int *rows, unsigned int num_rows);
+
+/**
+ * @brief Finishes a check and prints the same verdicts as CheckMatrix, or as CheckImg for
+ * digests with more than one channel.
+ * Only the kept blocks are compared with expected_path to locate the first mismatch.  If they
+ * all match it, the digest is out of date: no verdict is printed and the digest must be
+ * regenerated.  Frees the check's state.
+ *
+ * @return CL_SUCCESS if and only if the result matches.
+ */
+cl_int FinishDigestCheck(DigestCheck *check, const char *expected_path);
+
+/**
+ * @brief CheckMatrix equivalent that only needs the expected output's digest in memory.
+ */
+cl_int CheckMatrixDigest(const char *digest_path, const char *expected_path, Matrix *student);
+
+/**
+ * @brief CheckImg equivalent that only needs the expected output's digest in memory.
+ */
+cl_int CheckImgDigest(const char *digest_path, const char *expected_path, Image *student);
+
+/**
+ * @brief Checks a device buffer against a digest, reading it back one block at a time
+ * so the full result is never materialized on the host.
+ */
+cl_int OclCheckBufferDigest(cl_command_queue queue, cl_mem buffer, const char *digest_path,
+                            const char *expected_path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "device.h"
+#include "taskgraph.h"
+
+#define GRAPH_TEST_SIZE 4096
+#define GRAPH_TEST_QUEUES 2
+#define GRAPH_TEST_DEFAULT_RUNS 100
+
+static const char *diamond_source =
+    "__kernel void add_one(__global const int *in, __global int *out)\n"
+    "{\n"
+    "    size_t i = get_global_id(0);\n"
+    "    out[i] = in[i] + 1;\n"
+    "}\n"
+    "\n"
+    "__kernel void times_two(__global const int *in, __global int *out)\n"
+    "{\n"
+    "    size_t i = get_global_id(0);\n"
+    "    out[i] = in[i] * 2;\n"
+    "}\n"
+    "\n"
+    "__kernel void sum(__global const int *a, __global const int *b, __global int *out)\n"
+    "{\n"
+    "    size_t i = get_global_id(0);\n"
+    "    out[i] = a[i] + b[i];\n"
+    "}\n";
+
+typedef struct _DiamondCheck
+{
+    const int *input;
+    const int *output;
+    int mismatches;
+} DiamondCheck;
+
+/**
+ * @brief Host task at the bottom of the diamond: output must be (input + 1) + input * 2.
+ */
+static void CheckDiamond(void *user_data)
+{
+    DiamondCheck *check = (DiamondCheck *)user_data;
+
+    check->mismatches = 0;
+    for (int i = 0; i < GRAPH_TEST_SIZE; i++)
+        if (check->output[i] != 3 * check->input[i] + 1)
+            check->mismatches++;
+}
+
+int main(int argc, char **argv)
+{
+    static int input[GRAPH_TEST_SIZE], output[GRAPH_TEST_SIZE];
+    cl_device_id device_id;
+    cl_mem buffers[4] = {NULL};
+    cl_kernel kernels[3] = {NULL};
+    OclTaskGraph graph;
+    cl_int status;
+
+    int runs = argc > 1 ? atoi(argv[1]) : GRAPH_TEST_DEFAULT_RUNS;
+    if (runs <= 0)
+    {
+        fprintf(stderr, "Usage: %s [RUNS]\n", argv[0]);
+        return 1;
+    }
+
+    status = OclGetDeviceWithFallback(&device_id, OCL_DEVICE_TYPE);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to find a device (%d)\n", status);
+        return 1;
+    }
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &status);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to create a context (%d)\n", status);
+        return 1;
+    }
+
+    cl_program program = clCreateProgramWithSource(context, 1, &diamond_source, NULL, &status);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to create the diamond program (%d)\n", status);
+        return 1;
+    }
+
+    status = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+    if (status != CL_SUCCESS)
+    {
+        char log[4096];
+        fprintf(stderr, "Unable to build the diamond kernels (%d)\n", status);
+        if (clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, sizeof(log), log, NULL) == CL_SUCCESS)
+            fprintf(stderr, "%s\n", log);
+        return 1;
+    }
+
+    const char *names[3] = {"add_one", "times_two", "sum"};
+    for (int k = 0; k < 3 && status == CL_SUCCESS; k++)
+        kernels[k] = clCreateKernel(program, names[k], &status);
+    for (int b = 0; b < 4 && status == CL_SUCCESS; b++)
+        buffers[b] = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(input), NULL, &status);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to create kernels and buffers (%d)\n", status);
+        return 1;
+    }
+
+    // a -> {b = a + 1, c = a * 2} -> d = b + c, as {kernel, argument, buffer}.
+    const int args[7][3] = {{0, 0, 0}, {0, 1, 1}, {1, 0, 0}, {1, 1, 2}, {2, 0, 1}, {2, 1, 2}, {2, 2, 3}};
+    for (int a = 0; a < 7 && status == CL_SUCCESS; a++)
+        status = clSetKernelArg(kernels[args[a][0]], args[a][1], sizeof(cl_mem), &buffers[args[a][2]]);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to set the diamond kernel arguments (%d)\n", status);
+        return 1;
+    }
+
+    DiamondCheck check = {input, output, 0};
+    size_t global_size = GRAPH_TEST_SIZE;
+    cl_uint write, left, right, join, read, verify;
+
+    status = OclCreateTaskGraph(context, device_id, GRAPH_TEST_QUEUES, &graph);
+    if (status == CL_SUCCESS)
+        status = OclAddWriteTask(&graph, buffers[0], 0, sizeof(input), input, 0, NULL, &write);
+    if (status == CL_SUCCESS)
+        status = OclAddKernelTask(&graph, kernels[0], 1, &global_size, NULL, 1, &write, &left);
+    if (status == CL_SUCCESS)
+        status = OclAddKernelTask(&graph, kernels[1], 1, &global_size, NULL, 1, &write, &right);
+    cl_uint branches[2] = {left, right};
+    if (status == CL_SUCCESS)
+        status = OclAddKernelTask(&graph, kernels[2], 1, &global_size, NULL, 2, branches, &join);
+    if (status == CL_SUCCESS)
+        status = OclAddReadTask(&graph, buffers[3], 0, sizeof(output), output, 1, &join, &read);
+    if (status == CL_SUCCESS)
+        status = OclAddHostTask(&graph, CheckDiamond, &check, 1, &read, &verify);
+    if (status == CL_SUCCESS)
+        status = OclBuildTaskGraph(&graph);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to build the task graph (%d)\n", status);
+        return 1;
+    }
+
+    if (graph.tasks[left].queue == graph.tasks[right].queue)
+        printf("\033[33mWarning: both branches share queue %u.\033[0m\n", graph.tasks[left].queue);
+
+    // Fresh input every run, so a replay that reuses stale results is caught.
+    int failed_runs = 0;
+    for (int run = 0; run < runs; run++)
+    {
+        for (int i = 0; i < GRAPH_TEST_SIZE; i++)
+            input[i] = run * GRAPH_TEST_SIZE + i;
+
+        status = OclRunTaskGraph(&graph);
+        if (status != CL_SUCCESS || check.mismatches != 0)
+        {
+            printf("Run %d: status %d, %d mismatches\n", run, status, check.mismatches);
+            failed_runs++;
+        }
+    }
+
+    if (failed_runs == 0)
+        printf("!!SOLUTION IS CORRECT!! %d runs\n", runs);
+    else
+        printf("!!SOLUTION IS NOT CORRECT!! %d of %d runs failed\n", failed_runs, runs);
+
+    OclReleaseTaskGraph(&graph);
+    for (int b = 0; b < 4; b++)
+        clReleaseMemObject(buffers[b]);
+    for (int k = 0; k < 3; k++)
+        clReleaseKernel(kernels[k]);
+    clReleaseProgram(program);
+    clReleaseContext(context);
+
+    return failed_runs == 0 ? 0 : 1;
+}
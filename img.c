@@ -6,7 +6,24 @@
 
 #define RGB_COMPONENT_COLOR 255
 
+static void *AllocImgData(HostAllocFn alloc, void *user_data, size_t bytes)
+{
+    if (alloc)
+        return alloc(bytes, user_data);
+    return malloc(bytes);
+}
+
 cl_int LoadImg(const char *path, Image* img)
+{
+    return LoadImgWithAllocator(path, img, NULL, NULL);
+}
+
+cl_int LoadImgFromArena(const char *path, Image* img, HostArena *arena)
+{
+    return LoadImgWithAllocator(path, img, ArenaAllocator, arena);
+}
+
+cl_int LoadImgWithAllocator(const char *path, Image* img, HostAllocFn alloc, void *user_data)
 {
     char buff[16];
     FILE *fp;
@@ -21,12 +38,14 @@ cl_int LoadImg(const char *path, Image* img)
     //read image format
     if (!fgets(buff, sizeof(buff), fp)) {
         perror(path);
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
     //check the image format
     if (buff[0] != 'P' || buff[1] != '6') {
         fprintf(stderr, "Invalid image format (must be 'P6')\n");
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
@@ -41,34 +60,47 @@ cl_int LoadImg(const char *path, Image* img)
     //read image size information
     if (fscanf(fp, "%d %d", &img->shape[1], &img->shape[0]) != 2) {
         fprintf(stderr, "Invalid image size (error loading '%s')\n", path);
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
     //read rgb component
     if (fscanf(fp, "%d", &rgb_comp_color) != 1) {
         fprintf(stderr, "Invalid rgb component (error loading '%s')\n", path);
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
     //check rgb component depth
     if (rgb_comp_color != RGB_COMPONENT_COLOR) {
         fprintf(stderr, "'%s' does not have 8-bits components\n", path);
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
     while (fgetc(fp) != '\n') ;
     //memory allocation for pixel data
     unsigned char* data = (unsigned char *)malloc(img->shape[0] * img->shape[1] * IMAGE_CHANNELS * sizeof(char));
-    img->data = (int *)malloc(img->shape[0] * img->shape[1] * IMAGE_CHANNELS * sizeof(int));
+    img->data = (int *)AllocImgData(alloc, user_data, img->shape[0] * img->shape[1] * IMAGE_CHANNELS * sizeof(int));
 
     if (!data || !img->data) {
         fprintf(stderr, "Unable to allocate memory\n");
+        free(data);
+        if (!alloc)
+            free(img->data);
+        img->data = NULL;
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
     //read pixel data from file
     if (fread(data, IMAGE_CHANNELS * img->shape[0], img->shape[1], fp) != img->shape[1]) {
         fprintf(stderr, "Error loading image '%s'\n", path);
+        free(data);
+        if (!alloc)
+            free(img->data);
+        img->data = NULL;
+        fclose(fp);
         return CL_INVALID_VALUE;
     }
 
@@ -85,6 +117,16 @@ cl_int LoadImg(const char *path, Image* img)
 }
 
 cl_int LoadImgRaw(const char *path, Image* img)
+{
+    return LoadImgRawWithAllocator(path, img, NULL, NULL);
+}
+
+cl_int LoadImgRawFromArena(const char *path, Image* img, HostArena *arena)
+{
+    return LoadImgRawWithAllocator(path, img, ArenaAllocator, arena);
+}
+
+cl_int LoadImgRawWithAllocator(const char *path, Image* img, HostAllocFn alloc, void *user_data)
 {
     FILE *data_file;
 
@@ -100,6 +142,7 @@ cl_int LoadImgRaw(const char *path, Image* img)
     
     if (fscanf(data_file, "# (%u, %u, %u)\n", &rows, &cols, &channels) == EOF) {
         printf("Could not parse header.\n");
+        fclose(data_file);
         return CL_INVALID_VALUE; // Error parsing dimensions
     }
 
@@ -117,13 +160,17 @@ cl_int LoadImgRaw(const char *path, Image* img)
     img->shape[1] = cols;
     img->shape[2] = channels;
 
-    img->data = malloc(sizeof(int) * rows * cols * channels);
+    img->data = AllocImgData(alloc, user_data, sizeof(int) * rows * cols * channels);
     if (!img->data){ // Error mallocing matrix data
+        fclose(data_file);
         return CL_OUT_OF_HOST_MEMORY;
     }
 
-    int n = 0;
-    while (fscanf(data_file, "%d", &(img->data[n++])) != EOF);
+    unsigned int count = rows * cols * channels;
+    for (unsigned int n = 0; n < count; n++) {
+        if (fscanf(data_file, "%d", &(img->data[n])) != 1)
+            break;
+    }
 
     fclose(data_file);
 
@@ -145,6 +192,10 @@ cl_int SaveImg(const char *path, Image* img)
 {
     int count = img->shape[0] * img->shape[1] * 3;
     unsigned char* data = (unsigned char *)malloc(img->shape[0] * img->shape[1] * IMAGE_CHANNELS * sizeof(char));
+    if (!data) {
+        fprintf(stderr, "Unable to allocate memory\n");
+        return CL_OUT_OF_HOST_MEMORY;
+    }
 
     for (int i = 0; i < count; i++)
     {
@@ -156,6 +207,7 @@ cl_int SaveImg(const char *path, Image* img)
     fp = fopen(path, "wb");
     if (!fp) {
         fprintf(stderr, "Unable to open file '%s'\n", path);
+        free(data);
         return CL_INVALID_VALUE;
     }
 
@@ -204,3 +256,9 @@ cl_int CheckImg(Image *truth, Image *student)
     printf("!!SOLUTION IS CORRECT!!\n");
     return CL_SUCCESS;
 }
+
+void FreeImg(Image *img)
+{
+    free(img->data);
+    img->data = NULL;
+}
@@ -7,6 +7,8 @@
 #include <CL/cl.h>
 #endif
 
+#include "arena.h"
+
 #define IMAGE_CHANNELS 3
 
 typedef struct _Image 
@@ -20,3 +22,13 @@ cl_int LoadStride(const char *dir, int *stride);
 cl_int LoadImgRaw(const char *path, Image* img);
 cl_int SaveImg(const char *path, Image *matrix);
 cl_int CheckImg(Image *truth, Image *student);
+
+// As LoadImg and LoadImgRaw, but the data is allocated from arena.
+cl_int LoadImgFromArena(const char *path, Image* img, HostArena *arena);
+cl_int LoadImgRawFromArena(const char *path, Image* img, HostArena *arena);
+// As LoadImg and LoadImgRaw, but the data is allocated with alloc.  A NULL alloc uses malloc.
+cl_int LoadImgWithAllocator(const char *path, Image* img, HostAllocFn alloc, void *user_data);
+cl_int LoadImgRawWithAllocator(const char *path, Image* img, HostAllocFn alloc, void *user_data);
+// Frees an image allocated by LoadImg or LoadImgRaw.
+// Images loaded from an arena are released with ResetArena or ReleaseArena instead.
+void FreeImg(Image *img);
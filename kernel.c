@@ -15,14 +15,20 @@ char *OclLoadKernel(const char *path)
 
     // Get kernel size
     if (fseek(kernel_file, 0L, SEEK_END) != 0)
+    {
+        fclose(kernel_file);
         return NULL;
+    }
 
     kernel_size = ftell(kernel_file) + 1; // null terminator
     rewind(kernel_file);                  // Reset file position
 
     kernel_source = (char *)malloc(kernel_size);
-    if (!kernel_size) // Not enough host memory
+    if (!kernel_source) // Not enough host memory
+    {
+        fclose(kernel_file);
         return NULL;
+    }
 
     size_t kernel_count = fread(kernel_source, 1, kernel_size, kernel_file);
     kernel_source[kernel_count] = '\0'; // Add null terminator
@@ -1,10 +1,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "matrix.h"
 
+/**
+ * @brief Allocates matrix data from an arena, or from the heap if arena is NULL.
+ */
+static void *AllocMatrixData(HostArena *arena, size_t bytes, size_t alignment)
+{
+    if (arena)
+        return AllocFromArena(arena, bytes, alignment);
+
+    if (alignment)
+    {
+        void *data;
+        // posix_memalign needs at least pointer alignment; over-aligning the base is harmless.
+        if (alignment < sizeof(void *))
+            alignment = sizeof(void *);
+        if (posix_memalign(&data, alignment, bytes) != 0)
+            return NULL;
+        return data;
+    }
+
+    return malloc(bytes);
+}
+
 cl_int LoadMatrix(const char *path, Matrix *matrix)
+{
+    return LoadMatrixWithAllocator(path, matrix, NULL, NULL);
+}
+
+cl_int LoadMatrixFromArena(const char *path, Matrix *matrix, HostArena *arena)
+{
+    return LoadMatrixWithAllocator(path, matrix, ArenaAllocator, arena);
+}
+
+cl_int LoadMatrixWithAllocator(const char *path, Matrix *matrix, HostAllocFn alloc, void *user_data)
 {
     FILE *data_file;
 
@@ -15,7 +48,10 @@ cl_int LoadMatrix(const char *path, Matrix *matrix)
     unsigned int rows = 0;
     unsigned int cols = 0;
     if (fscanf(data_file, "# (%u, %u)\n", &rows, &cols) == EOF)
+    {
+        fclose(data_file);
         return CL_INVALID_VALUE; // Error parsing dimensions
+    }
 
     if (rows == 0)
         rows = 1;
@@ -25,13 +61,18 @@ cl_int LoadMatrix(const char *path, Matrix *matrix)
     matrix->shape[0] = rows;
     matrix->shape[1] = cols;
 
-    matrix->data = malloc(sizeof(int) * rows * cols);
+    size_t bytes = sizeof(int) * rows * cols;
+    matrix->data = alloc ? (int *)alloc(bytes, user_data) : (int *)malloc(bytes);
     if (!matrix->data) // Error mallocing matrix data
+    {
+        fclose(data_file);
         return CL_OUT_OF_HOST_MEMORY;
+    }
 
-    int n = 0;
-    while (fscanf(data_file, "%d", &(matrix->data[n++])) != EOF)
-        ;
+    unsigned int count = rows * cols;
+    for (unsigned int n = 0; n < count; n++)
+        if (fscanf(data_file, "%d", &(matrix->data[n])) != 1)
+            break;
     fclose(data_file);
 
     return CL_SUCCESS;
@@ -48,14 +89,20 @@ cl_int SaveMatrix(const char *path, Matrix *matrix)
     unsigned int rows = matrix->shape[0];
     unsigned int cols = matrix->shape[1];
     if (fprintf(data_file, "# (%u, %u)\n", rows, cols) < 0)
+    {
+        fclose(data_file);
         return CL_INVALID_VALUE; // Error parsing dimensions
+    }
     
     for (int r = 0; r < rows; r++)
     {
         for (int c = 0; c < cols; c++)
         {
-            if (fprintf(data_file, "%d ", matrix->data[cols * r + c]) < -1)
-                return CL_INVALID_VALUE; // Error parsing dimensions
+            if (fprintf(data_file, "%d ", matrix->data[cols * r + c]) < 0)
+            {
+                fclose(data_file);
+                return CL_INVALID_VALUE; // Error writing data
+            }
         }
         fprintf(data_file, "\n");
     }
@@ -104,3 +151,283 @@ void PrintMatrix(Matrix *matrix)
         printf("\n");
     }
 }
+
+void FreeMatrix(Matrix *matrix)
+{
+    free(matrix->data);
+    matrix->data = NULL;
+}
+
+#define MATRIX_RELAYOUT_BLOCK 32 // Edge of the cache blocks used by RelayoutMatrix and TransposeMatrix.
+
+static const MatrixLayout dense_layout = {MATRIX_ROW_MAJOR, 0, {0, 0}, 0};
+
+static unsigned int RoundUp(unsigned int value, unsigned int multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+cl_int ResolveMatrixLayout(const unsigned int shape[2], MatrixLayout *layout)
+{
+    if (layout->alignment && (layout->alignment % sizeof(int) != 0 ||
+                              (layout->alignment & (layout->alignment - 1)) != 0))
+        return CL_INVALID_VALUE; // Must be a power of two holding whole elements
+
+    unsigned int align = layout->alignment ? layout->alignment / sizeof(int) : 1;
+
+    switch (layout->order)
+    {
+    case MATRIX_ROW_MAJOR:
+    case MATRIX_COL_MAJOR:
+    {
+        unsigned int extent = layout->order == MATRIX_ROW_MAJOR ? shape[1] : shape[0];
+        if (layout->pitch == 0)
+            layout->pitch = RoundUp(extent, align);
+        if (layout->pitch < extent || layout->pitch % align != 0)
+            return CL_INVALID_VALUE;
+        layout->block[0] = 0;
+        layout->block[1] = 0;
+        return CL_SUCCESS;
+    }
+    case MATRIX_BLOCKED:
+        if (layout->block[0] == 0 || layout->block[1] == 0 ||
+            (layout->block[0] * layout->block[1]) % align != 0)
+            return CL_INVALID_VALUE;
+        layout->pitch = RoundUp(shape[1], layout->block[1]);
+        return CL_SUCCESS;
+    default:
+        return CL_INVALID_VALUE;
+    }
+}
+
+/**
+ * @brief Copies a layout, resolving it if its pitch has not been filled in yet.
+ * NULL is the dense row-major layout.
+ *
+ * @return CL_SUCCESS if and only if the copy is a valid, resolved layout.
+ */
+static cl_int ResolvedLayoutCopy(const unsigned int shape[2], const MatrixLayout *layout,
+                                 MatrixLayout *resolved)
+{
+    *resolved = layout ? *layout : dense_layout;
+    if (resolved->pitch != 0 && resolved->order != MATRIX_BLOCKED)
+        return CL_SUCCESS;
+    return ResolveMatrixLayout(shape, resolved);
+}
+
+size_t MatrixLayoutSize(const unsigned int shape[2], const MatrixLayout *layout)
+{
+    MatrixLayout resolved;
+    if (ResolvedLayoutCopy(shape, layout, &resolved) != CL_SUCCESS)
+        return 0;
+
+    switch (resolved.order)
+    {
+    case MATRIX_COL_MAJOR:
+        return (size_t)resolved.pitch * shape[1];
+    case MATRIX_BLOCKED:
+        return (size_t)RoundUp(shape[0], resolved.block[0]) * resolved.pitch;
+    default:
+        return (size_t)resolved.pitch * shape[0];
+    }
+}
+
+size_t MatrixLayoutIndex(const unsigned int shape[2], const MatrixLayout *layout,
+                         unsigned int r, unsigned int c)
+{
+    if (!layout)
+        return (size_t)r * shape[1] + c;
+
+    MatrixLayout resolved;
+    if (ResolvedLayoutCopy(shape, layout, &resolved) != CL_SUCCESS)
+        return (size_t)-1;
+
+    switch (resolved.order)
+    {
+    case MATRIX_COL_MAJOR:
+        return (size_t)c * resolved.pitch + r;
+    case MATRIX_BLOCKED:
+    {
+        size_t block_rows = resolved.block[0];
+        size_t block_cols = resolved.block[1];
+        size_t blocks_per_row = resolved.pitch / block_cols;
+        size_t block = (r / block_rows) * blocks_per_row + c / block_cols;
+        return block * block_rows * block_cols + (r % block_rows) * block_cols + c % block_cols;
+    }
+    default:
+        return (size_t)r * resolved.pitch + c;
+    }
+}
+
+cl_int MatrixLayoutOptions(const Matrix *matrix, const MatrixLayout *layout,
+                           char *options, size_t size)
+{
+    MatrixLayout resolved;
+    if (ResolvedLayoutCopy(matrix->shape, layout, &resolved) != CL_SUCCESS)
+        return CL_INVALID_VALUE;
+    layout = &resolved;
+    unsigned int pitch = resolved.pitch;
+
+    int written = snprintf(options, size,
+                           "-DMATRIX_ROWS=%u -DMATRIX_COLS=%u -DMATRIX_PITCH=%u -DMATRIX_ORDER=%d "
+                           "-DMATRIX_BLOCK_ROWS=%u -DMATRIX_BLOCK_COLS=%u",
+                           matrix->shape[0], matrix->shape[1], pitch, (int)layout->order,
+                           layout->block[0], layout->block[1]);
+    if (written < 0 || (size_t)written >= size)
+        return CL_INVALID_VALUE; // Options buffer too small
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Allocates zeroed storage for a matrix in the given layout.
+ * Padding must be zero so that blocked kernels can read whole blocks.
+ */
+static cl_int AllocMatrixLayout(Matrix *matrix, const MatrixLayout *layout, HostArena *arena)
+{
+    size_t bytes = MatrixLayoutSize(matrix->shape, layout) * sizeof(int);
+    size_t alignment = layout ? layout->alignment : 0;
+
+    if (alignment)
+        bytes = (bytes + alignment - 1) / alignment * alignment;
+
+    matrix->data = AllocMatrixData(arena, bytes, alignment);
+    if (!matrix->data)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    memset(matrix->data, 0, bytes);
+    return CL_SUCCESS;
+}
+
+cl_int LoadMatrixLayout(const char *path, Matrix *matrix, MatrixLayout *layout)
+{
+    return LoadMatrixLayoutFromArena(path, matrix, layout, NULL);
+}
+
+cl_int LoadMatrixLayoutFromArena(const char *path, Matrix *matrix, MatrixLayout *layout,
+                                 HostArena *arena)
+{
+    MatrixLayout dense = dense_layout;
+    FILE *data_file;
+    cl_int status;
+
+    if (!layout)
+        layout = &dense;
+
+    data_file = fopen(path, "r");
+    if (!data_file) // Error opening file
+        return CL_INVALID_VALUE;
+
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    if (fscanf(data_file, "# (%u, %u)\n", &rows, &cols) == EOF)
+    {
+        fclose(data_file);
+        return CL_INVALID_VALUE; // Error parsing dimensions
+    }
+
+    if (rows == 0)
+        rows = 1;
+    if (cols == 0)
+        cols = 1;
+
+    matrix->shape[0] = rows;
+    matrix->shape[1] = cols;
+
+    status = ResolveMatrixLayout(matrix->shape, layout);
+    if (status == CL_SUCCESS)
+        status = AllocMatrixLayout(matrix, layout, arena);
+    if (status != CL_SUCCESS)
+    {
+        fclose(data_file);
+        return status;
+    }
+
+    // Elements arrive in row-major order; scatter each one to its final position.
+    for (unsigned int r = 0; r < rows; r++)
+    {
+        for (unsigned int c = 0; c < cols; c++)
+        {
+            int value;
+            if (fscanf(data_file, "%d", &value) != 1)
+            {
+                fclose(data_file);
+                return CL_SUCCESS; // The rest of a short file is left zero filled
+            }
+            matrix->data[MatrixLayoutIndex(matrix->shape, layout, r, c)] = value;
+        }
+    }
+    fclose(data_file);
+
+    return CL_SUCCESS;
+}
+
+cl_int RelayoutMatrix(const Matrix *src, const MatrixLayout *src_layout,
+                      Matrix *dst, MatrixLayout *dst_layout)
+{
+    MatrixLayout dense = dense_layout;
+    MatrixLayout src_resolved;
+    cl_int status;
+
+    if (!dst_layout)
+        dst_layout = &dense;
+
+    // Resolve the source once instead of on every element.
+    status = ResolvedLayoutCopy(src->shape, src_layout, &src_resolved);
+    if (status != CL_SUCCESS)
+        return status;
+    src_layout = &src_resolved;
+
+    dst->shape[0] = src->shape[0];
+    dst->shape[1] = src->shape[1];
+
+    status = ResolveMatrixLayout(dst->shape, dst_layout);
+    if (status != CL_SUCCESS)
+        return status;
+    status = AllocMatrixLayout(dst, dst_layout, NULL);
+    if (status != CL_SUCCESS)
+        return status;
+
+    unsigned int rows = src->shape[0];
+    unsigned int cols = src->shape[1];
+    for (unsigned int rb = 0; rb < rows; rb += MATRIX_RELAYOUT_BLOCK)
+    {
+        unsigned int r_end = rb + MATRIX_RELAYOUT_BLOCK < rows ? rb + MATRIX_RELAYOUT_BLOCK : rows;
+        for (unsigned int cb = 0; cb < cols; cb += MATRIX_RELAYOUT_BLOCK)
+        {
+            unsigned int c_end = cb + MATRIX_RELAYOUT_BLOCK < cols ? cb + MATRIX_RELAYOUT_BLOCK : cols;
+            for (unsigned int r = rb; r < r_end; r++)
+                for (unsigned int c = cb; c < c_end; c++)
+                    dst->data[MatrixLayoutIndex(dst->shape, dst_layout, r, c)] =
+                        src->data[MatrixLayoutIndex(src->shape, src_layout, r, c)];
+        }
+    }
+
+    return CL_SUCCESS;
+}
+
+cl_int TransposeMatrix(const Matrix *src, Matrix *dst)
+{
+    unsigned int rows = src->shape[0];
+    unsigned int cols = src->shape[1];
+
+    dst->shape[0] = cols;
+    dst->shape[1] = rows;
+    dst->data = malloc(sizeof(int) * rows * cols);
+    if (!dst->data) // Error mallocing matrix data
+        return CL_OUT_OF_HOST_MEMORY;
+
+    for (unsigned int rb = 0; rb < rows; rb += MATRIX_RELAYOUT_BLOCK)
+    {
+        unsigned int r_end = rb + MATRIX_RELAYOUT_BLOCK < rows ? rb + MATRIX_RELAYOUT_BLOCK : rows;
+        for (unsigned int cb = 0; cb < cols; cb += MATRIX_RELAYOUT_BLOCK)
+        {
+            unsigned int c_end = cb + MATRIX_RELAYOUT_BLOCK < cols ? cb + MATRIX_RELAYOUT_BLOCK : cols;
+            for (unsigned int r = rb; r < r_end; r++)
+                for (unsigned int c = cb; c < c_end; c++)
+                    dst->data[(size_t)c * rows + r] = src->data[(size_t)r * cols + c];
+        }
+    }
+
+    return CL_SUCCESS;
+}
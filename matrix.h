@@ -11,16 +11,65 @@ extern "C" {
 #include <CL/cl.h>
 #endif
 
+#include "arena.h"
+
 typedef struct _Matrix
 {
     int *data;
     unsigned int shape[2];
 } Matrix;
 
+typedef enum _MatrixOrder
+{
+    MATRIX_ROW_MAJOR = 0,
+    MATRIX_COL_MAJOR,
+    MATRIX_BLOCKED, // Row-major grid of row-major blocks, zero padded to whole blocks.
+} MatrixOrder;
+
+// Describes how a Matrix's logical shape is laid out in its data.
+// A NULL or zeroed layout is the dense row-major layout used by LoadMatrix.
+typedef struct _MatrixLayout
+{
+    MatrixOrder order;
+    unsigned int pitch;     // Elements between rows (columns if col-major).  0 picks the smallest aligned pitch.
+    unsigned int block[2];  // Block shape for MATRIX_BLOCKED, e.g. 16x16.
+    unsigned int alignment; // Byte alignment of data and of every row/column.  0 for none.
+} MatrixLayout;
+
 cl_int LoadMatrix(const char *path, Matrix *matrix);
 cl_int SaveMatrix(const char *path, Matrix *matrix);
 cl_int CheckMatrix(Matrix *truth, Matrix *student);
 void PrintMatrix(Matrix *matrix);
+// Frees a matrix allocated by LoadMatrix, LoadMatrixLayout, RelayoutMatrix or TransposeMatrix.
+// Matrices loaded from an arena are released with ResetArena or ReleaseArena instead.
+void FreeMatrix(Matrix *matrix);
+// As LoadMatrix, but the data is allocated from arena.
+cl_int LoadMatrixFromArena(const char *path, Matrix *matrix, HostArena *arena);
+// As LoadMatrix, but the data is allocated with alloc.  A NULL alloc uses malloc.
+cl_int LoadMatrixWithAllocator(const char *path, Matrix *matrix, HostAllocFn alloc, void *user_data);
+
+// Fills in the pitch of a layout for the given shape and validates it.
+cl_int ResolveMatrixLayout(const unsigned int shape[2], MatrixLayout *layout);
+// The layout helpers below resolve an unresolved (pitch 0) layout on the fly.
+// Number of elements (including padding) a matrix of this shape and layout occupies.  0 if the layout is invalid.
+size_t MatrixLayoutSize(const unsigned int shape[2], const MatrixLayout *layout);
+// Offset of element (r, c) in a matrix stored with the given layout.  (size_t)-1 if the layout is invalid.
+size_t MatrixLayoutIndex(const unsigned int shape[2], const MatrixLayout *layout,
+                         unsigned int r, unsigned int c);
+// Writes -D build options describing the layout (MATRIX_ROWS, MATRIX_COLS, MATRIX_PITCH,
+// MATRIX_ORDER, MATRIX_BLOCK_ROWS, MATRIX_BLOCK_COLS) for clBuildProgram.  CL_INVALID_VALUE if the layout is invalid.
+cl_int MatrixLayoutOptions(const Matrix *matrix, const MatrixLayout *layout,
+                           char *options, size_t size);
+
+// Loads a matrix straight into the requested layout while parsing.  Resolves *layout.
+cl_int LoadMatrixLayout(const char *path, Matrix *matrix, MatrixLayout *layout);
+cl_int LoadMatrixLayoutFromArena(const char *path, Matrix *matrix, MatrixLayout *layout,
+                                 HostArena *arena);
+// Cache-blocked copy of src into a newly allocated dst with a different layout.  Resolves *dst_layout.
+cl_int RelayoutMatrix(const Matrix *src, const MatrixLayout *src_layout,
+                      Matrix *dst, MatrixLayout *dst_layout);
+// Cache-blocked transpose of a dense row-major matrix into a newly allocated dst.
+cl_int TransposeMatrix(const Matrix *src, Matrix *dst);
 
 #ifdef __cplusplus
 }
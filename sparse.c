@@ -0,0 +1,504 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sparse.h"
+
+#define SPARSE_MAX_THREADS 64
+
+/**
+ * @brief Allocates the CSR arrays for a matrix with the given shape and nonzero count.
+ */
+static cl_int AllocSparseMatrix(SparseMatrix *matrix, unsigned int rows, unsigned int cols,
+                                unsigned int nnz)
+{
+    matrix->shape[0] = rows;
+    matrix->shape[1] = cols;
+    matrix->nnz = nnz;
+    matrix->row_ptr = (int *)calloc((size_t)rows + 1, sizeof(int));
+    matrix->col_idx = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    matrix->values = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+
+    if (!matrix->row_ptr || !matrix->col_idx || !matrix->values)
+    {
+        FreeSparseMatrix(matrix);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    return CL_SUCCESS;
+}
+
+void FreeSparseMatrix(SparseMatrix *matrix)
+{
+    free(matrix->row_ptr);
+    free(matrix->col_idx);
+    free(matrix->values);
+    matrix->row_ptr = NULL;
+    matrix->col_idx = NULL;
+    matrix->values = NULL;
+    matrix->nnz = 0;
+}
+
+/**
+ * @brief Sorts each row by column and sums duplicates, compacting the arrays in place.
+ */
+static void CompactSparseRows(SparseMatrix *matrix)
+{
+    unsigned int out = 0;
+
+    for (unsigned int r = 0; r < matrix->shape[0]; r++)
+    {
+        int start = matrix->row_ptr[r];
+        int end = matrix->row_ptr[r + 1];
+
+        // Rows are short in practice; insertion sort keeps this allocation free.
+        for (int i = start + 1; i < end; i++)
+        {
+            int col = matrix->col_idx[i];
+            int value = matrix->values[i];
+            int j = i - 1;
+            while (j >= start && matrix->col_idx[j] > col)
+            {
+                matrix->col_idx[j + 1] = matrix->col_idx[j];
+                matrix->values[j + 1] = matrix->values[j];
+                j--;
+            }
+            matrix->col_idx[j + 1] = col;
+            matrix->values[j + 1] = value;
+        }
+
+        matrix->row_ptr[r] = out;
+        for (int i = start; i < end; i++)
+        {
+            if (out > (unsigned int)matrix->row_ptr[r] && matrix->col_idx[out - 1] == matrix->col_idx[i])
+            {
+                matrix->values[out - 1] += matrix->values[i];
+                continue;
+            }
+            matrix->col_idx[out] = matrix->col_idx[i];
+            matrix->values[out] = matrix->values[i];
+            out++;
+        }
+    }
+
+    matrix->row_ptr[matrix->shape[0]] = out;
+    matrix->nnz = out;
+}
+
+cl_int LoadSparseMatrix(const char *path, SparseMatrix *matrix)
+{
+    FILE *data_file;
+    cl_int status;
+
+    data_file = fopen(path, "r");
+    if (!data_file) // Error opening file
+        return CL_INVALID_VALUE;
+
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    unsigned int nnz = 0;
+    if (fscanf(data_file, "# (%u, %u, %u)\n", &rows, &cols, &nnz) != 3 || rows == 0 || cols == 0)
+    {
+        fclose(data_file);
+        return CL_INVALID_VALUE; // Error parsing dimensions
+    }
+
+    unsigned int *entry_rows = (unsigned int *)malloc((nnz ? nnz : 1) * sizeof(unsigned int));
+    status = entry_rows ? AllocSparseMatrix(matrix, rows, cols, nnz) : CL_OUT_OF_HOST_MEMORY;
+    if (status != CL_SUCCESS)
+    {
+        free(entry_rows);
+        fclose(data_file);
+        return status;
+    }
+
+    // Read the triplets, counting entries per row as we go.
+    for (unsigned int n = 0; n < nnz; n++)
+    {
+        unsigned int r, c;
+        int value;
+        if (fscanf(data_file, "%u %u %d", &r, &c, &value) != 3 || r >= rows || c >= cols)
+        {
+            status = CL_INVALID_VALUE;
+            break;
+        }
+        entry_rows[n] = r;
+        matrix->col_idx[n] = c;
+        matrix->values[n] = value;
+        matrix->row_ptr[r + 1]++;
+    }
+    fclose(data_file);
+
+    if (status != CL_SUCCESS)
+    {
+        free(entry_rows);
+        FreeSparseMatrix(matrix);
+        return status;
+    }
+
+    for (unsigned int r = 0; r < rows; r++)
+        matrix->row_ptr[r + 1] += matrix->row_ptr[r];
+
+    // Counting sort of the triplets into their rows.
+    int *col_idx = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    int *values = (int *)malloc((nnz ? nnz : 1) * sizeof(int));
+    int *next = (int *)malloc(((size_t)rows + 1) * sizeof(int));
+    if (!col_idx || !values || !next)
+    {
+        free(col_idx);
+        free(values);
+        free(next);
+        free(entry_rows);
+        FreeSparseMatrix(matrix);
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+
+    memcpy(next, matrix->row_ptr, ((size_t)rows + 1) * sizeof(int));
+    for (unsigned int n = 0; n < nnz; n++)
+    {
+        int slot = next[entry_rows[n]]++;
+        col_idx[slot] = matrix->col_idx[n];
+        values[slot] = matrix->values[n];
+    }
+
+    free(next);
+    free(entry_rows);
+    free(matrix->col_idx);
+    free(matrix->values);
+    matrix->col_idx = col_idx;
+    matrix->values = values;
+
+    CompactSparseRows(matrix);
+
+    return CL_SUCCESS;
+}
+
+cl_int SaveSparseMatrix(const char *path, const SparseMatrix *matrix)
+{
+    FILE *data_file;
+
+    data_file = fopen(path, "w");
+    if (!data_file) // Error opening file
+        return CL_INVALID_VALUE;
+
+    fprintf(data_file, "# (%u, %u, %u)\n", matrix->shape[0], matrix->shape[1], matrix->nnz);
+    for (unsigned int r = 0; r < matrix->shape[0]; r++)
+        for (int i = matrix->row_ptr[r]; i < matrix->row_ptr[r + 1]; i++)
+            fprintf(data_file, "%u %d %d\n", r, matrix->col_idx[i], matrix->values[i]);
+
+    int failed = ferror(data_file);
+    fclose(data_file);
+
+    return failed ? CL_INVALID_VALUE : CL_SUCCESS;
+}
+
+cl_int LoadSparseMatrixBinary(const char *path, SparseMatrix *matrix)
+{
+    FILE *data_file;
+    char magic[4];
+    cl_uint header[3];
+    cl_int status;
+
+    data_file = fopen(path, "rb");
+    if (!data_file) // Error opening file
+        return CL_INVALID_VALUE;
+
+    if (fread(magic, 1, sizeof(magic), data_file) != sizeof(magic) ||
+        memcmp(magic, SPARSE_BINARY_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(cl_uint), 3, data_file) != 3 || header[0] == 0 || header[1] == 0)
+    {
+        fclose(data_file);
+        return CL_INVALID_VALUE;
+    }
+
+    status = AllocSparseMatrix(matrix, header[0], header[1], header[2]);
+    if (status != CL_SUCCESS)
+    {
+        fclose(data_file);
+        return status;
+    }
+
+    size_t rows = header[0];
+    size_t nnz = header[2];
+    if (fread(matrix->row_ptr, sizeof(int), rows + 1, data_file) != rows + 1 ||
+        fread(matrix->col_idx, sizeof(int), nnz, data_file) != nnz ||
+        fread(matrix->values, sizeof(int), nnz, data_file) != nnz)
+        status = CL_INVALID_VALUE;
+    fclose(data_file);
+
+    // Validate the structure once here so kernels can trust it.
+    if (status == CL_SUCCESS && (matrix->row_ptr[0] != 0 || (size_t)matrix->row_ptr[rows] != nnz))
+        status = CL_INVALID_VALUE;
+    for (size_t r = 0; r < rows && status == CL_SUCCESS; r++)
+    {
+        if (matrix->row_ptr[r] > matrix->row_ptr[r + 1])
+        {
+            status = CL_INVALID_VALUE;
+            break;
+        }
+        // Column indices must be in range, sorted and unique within each row.
+        for (int i = matrix->row_ptr[r]; i < matrix->row_ptr[r + 1]; i++)
+        {
+            if (matrix->col_idx[i] < 0 || (unsigned int)matrix->col_idx[i] >= matrix->shape[1] ||
+                (i > matrix->row_ptr[r] && matrix->col_idx[i] <= matrix->col_idx[i - 1]))
+            {
+                status = CL_INVALID_VALUE;
+                break;
+            }
+        }
+    }
+
+    if (status != CL_SUCCESS)
+        FreeSparseMatrix(matrix);
+
+    return status;
+}
+
+cl_int SaveSparseMatrixBinary(const char *path, const SparseMatrix *matrix)
+{
+    FILE *data_file;
+    cl_uint header[3] = {matrix->shape[0], matrix->shape[1], matrix->nnz};
+
+    data_file = fopen(path, "wb");
+    if (!data_file) // Error opening file
+        return CL_INVALID_VALUE;
+
+    size_t rows = matrix->shape[0];
+    size_t nnz = matrix->nnz;
+    int failed = fwrite(SPARSE_BINARY_MAGIC, 1, 4, data_file) != 4 ||
+                 fwrite(header, sizeof(cl_uint), 3, data_file) != 3 ||
+                 fwrite(matrix->row_ptr, sizeof(int), rows + 1, data_file) != rows + 1 ||
+                 fwrite(matrix->col_idx, sizeof(int), nnz, data_file) != nnz ||
+                 fwrite(matrix->values, sizeof(int), nnz, data_file) != nnz;
+    fclose(data_file);
+
+    return failed ? CL_INVALID_VALUE : CL_SUCCESS;
+}
+
+cl_int DenseToSparse(const Matrix *dense, SparseMatrix *sparse)
+{
+    unsigned int rows = dense->shape[0];
+    unsigned int cols = dense->shape[1];
+    size_t count = (size_t)rows * cols;
+    unsigned int nnz = 0;
+    cl_int status;
+
+    for (size_t i = 0; i < count; i++)
+        if (dense->data[i] != 0)
+            nnz++;
+
+    status = AllocSparseMatrix(sparse, rows, cols, nnz);
+    if (status != CL_SUCCESS)
+        return status;
+
+    unsigned int n = 0;
+    for (unsigned int r = 0; r < rows; r++)
+    {
+        sparse->row_ptr[r] = n;
+        for (unsigned int c = 0; c < cols; c++)
+        {
+            int value = dense->data[(size_t)r * cols + c];
+            if (value != 0)
+            {
+                sparse->col_idx[n] = c;
+                sparse->values[n] = value;
+                n++;
+            }
+        }
+    }
+    sparse->row_ptr[rows] = n;
+
+    return CL_SUCCESS;
+}
+
+cl_int SparseToDense(const SparseMatrix *sparse, Matrix *dense)
+{
+    unsigned int rows = sparse->shape[0];
+    unsigned int cols = sparse->shape[1];
+
+    dense->shape[0] = rows;
+    dense->shape[1] = cols;
+    dense->data = (int *)calloc((size_t)rows * cols, sizeof(int));
+    if (!dense->data) // Error mallocing matrix data
+        return CL_OUT_OF_HOST_MEMORY;
+
+    for (unsigned int r = 0; r < rows; r++)
+        for (int i = sparse->row_ptr[r]; i < sparse->row_ptr[r + 1]; i++)
+            dense->data[(size_t)r * cols + sparse->col_idx[i]] = sparse->values[i];
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief A contiguous range of rows handled by one host thread.
+ */
+typedef struct _SparseWork
+{
+    const SparseMatrix *a;
+    const int *b;       // x for SpMV, B's data for SpMM.
+    int *c;             // y for SpMV, C's data for SpMM.
+    unsigned int b_cols; // 1 for SpMV.
+    unsigned int row_begin;
+    unsigned int row_end;
+} SparseWork;
+
+static void *SparseMultiplyRows(void *arg)
+{
+    const SparseWork *work = (const SparseWork *)arg;
+    const SparseMatrix *a = work->a;
+    unsigned int n = work->b_cols;
+
+    for (unsigned int r = work->row_begin; r < work->row_end; r++)
+    {
+        int *out = work->c + (size_t)r * n;
+        memset(out, 0, n * sizeof(int));
+        for (int i = a->row_ptr[r]; i < a->row_ptr[r + 1]; i++)
+        {
+            int value = a->values[i];
+            const int *in = work->b + (size_t)a->col_idx[i] * n;
+            for (unsigned int j = 0; j < n; j++)
+                out[j] += value * in[j];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Splits A's rows over threads so that each gets about the same number of nonzeros.
+ */
+static cl_int SparseMultiply(const SparseMatrix *a, const int *b, int *c, unsigned int b_cols,
+                             unsigned int num_threads)
+{
+    pthread_t threads[SPARSE_MAX_THREADS];
+    bool started[SPARSE_MAX_THREADS];
+    SparseWork work[SPARSE_MAX_THREADS];
+
+    if (num_threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = online > 0 ? (unsigned int)online : 1;
+    }
+    if (num_threads > SPARSE_MAX_THREADS)
+        num_threads = SPARSE_MAX_THREADS;
+    if (num_threads > a->shape[0])
+        num_threads = a->shape[0] ? a->shape[0] : 1;
+
+    unsigned int row = 0;
+    for (unsigned int t = 0; t < num_threads; t++)
+    {
+        // First row whose prefix holds this thread's share of the nonzeros.
+        size_t target = (size_t)a->nnz * (t + 1) / num_threads;
+        unsigned int end = row;
+        while (end < a->shape[0] && (size_t)a->row_ptr[end] < target)
+            end++;
+        if (t == num_threads - 1)
+            end = a->shape[0];
+
+        work[t] = (SparseWork){a, b, c, b_cols, row, end};
+        row = end;
+
+        // The calling thread takes the last share, and any share a thread could not be started for.
+        started[t] = t < num_threads - 1 &&
+                     pthread_create(&threads[t], NULL, SparseMultiplyRows, &work[t]) == 0;
+        if (!started[t])
+            SparseMultiplyRows(&work[t]);
+    }
+
+    for (unsigned int t = 0; t < num_threads; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+
+    return CL_SUCCESS;
+}
+
+cl_int SparseMatVec(const SparseMatrix *a, const int *x, int *y, unsigned int num_threads)
+{
+    return SparseMultiply(a, x, y, 1, num_threads);
+}
+
+cl_int SparseMatMul(const SparseMatrix *a, const Matrix *b, Matrix *c, unsigned int num_threads)
+{
+    if (a->shape[1] != b->shape[0])
+    {
+        printf("!!INCORRECT SHAPE!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    c->shape[0] = a->shape[0];
+    c->shape[1] = b->shape[1];
+    c->data = (int *)malloc(sizeof(int) * c->shape[0] * c->shape[1]);
+    if (!c->data) // Error mallocing matrix data
+        return CL_OUT_OF_HOST_MEMORY;
+
+    return SparseMultiply(a, b->data, c->data, b->shape[1], num_threads);
+}
+
+cl_int CheckSparseMatrix(SparseMatrix *truth, Matrix *student)
+{
+    if (truth->shape[0] != student->shape[0] || truth->shape[1] != student->shape[1])
+    {
+        printf("!!INCORRECT SHAPE!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    unsigned int cols = truth->shape[1];
+    for (unsigned int r = 0; r < truth->shape[0]; r++)
+    {
+        const int *row = student->data + (size_t)r * cols;
+        unsigned int c = 0;
+
+        // Walk the row once: stored entries must match, everything between them must be zero.
+        for (int i = truth->row_ptr[r]; i <= truth->row_ptr[r + 1]; i++)
+        {
+            unsigned int next = i < truth->row_ptr[r + 1] ? (unsigned int)truth->col_idx[i] : cols;
+            for (; c < next; c++)
+            {
+                if (row[c] != 0)
+                {
+                    printf("!!SOLUTION IS NOT CORRECT!!\n");
+                    return CL_INVALID_VALUE;
+                }
+            }
+            if (next < cols)
+            {
+                if (row[c] != truth->values[i])
+                {
+                    printf("!!SOLUTION IS NOT CORRECT!!\n");
+                    return CL_INVALID_VALUE;
+                }
+                c++;
+            }
+        }
+    }
+
+    printf("!!SOLUTION IS CORRECT!!\n");
+    return CL_SUCCESS;
+}
+
+cl_int OclCreateSparseBuffers(cl_context context, cl_mem_flags flags, const SparseMatrix *matrix,
+                              cl_mem buffers[3])
+{
+    int *arrays[3] = {matrix->row_ptr, matrix->col_idx, matrix->values};
+    size_t counts[3] = {(size_t)matrix->shape[0] + 1, matrix->nnz ? matrix->nnz : 1, matrix->nnz ? matrix->nnz : 1};
+    cl_int status = CL_SUCCESS;
+
+    for (int i = 0; i < 3; i++)
+        buffers[i] = NULL;
+
+    for (int i = 0; i < 3 && status == CL_SUCCESS; i++)
+        buffers[i] = clCreateBuffer(context, flags | CL_MEM_COPY_HOST_PTR, counts[i] * sizeof(int),
+                                    arrays[i], &status);
+
+    if (status != CL_SUCCESS)
+    {
+        for (int i = 0; i < 3; i++)
+            if (buffers[i])
+                clReleaseMemObject(buffers[i]);
+    }
+
+    return status;
+}
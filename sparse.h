@@ -0,0 +1,107 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#include "matrix.h"
+
+#define SPARSE_BINARY_MAGIC "CSR1"
+
+/**
+ * @brief A sparse matrix in compressed sparse row (CSR) form.
+ * Column indices are sorted and unique within each row.  Every array is a plain int array,
+ * so each can be uploaded to the device as-is.
+ */
+typedef struct _SparseMatrix
+{
+    unsigned int shape[2];
+    unsigned int nnz;
+    int *row_ptr; // shape[0] + 1 entries.
+    int *col_idx; // nnz entries.
+    int *values;  // nnz entries.
+} SparseMatrix;
+
+/**
+ * @brief Loads a sparse matrix from text in coordinate (COO) form:
+ * a "# (rows, cols, nnz)" header followed by nnz "row col value" lines in any order.
+ * Duplicate entries are summed.
+ * The caller is responsible for calling FreeSparseMatrix.
+ *
+ * @return CL_SUCCESS if and only if the file is read and every index is in range.
+ */
+cl_int LoadSparseMatrix(const char *path, SparseMatrix *matrix);
+
+/**
+ * @brief Saves a sparse matrix as COO text readable by LoadSparseMatrix.
+ */
+cl_int SaveSparseMatrix(const char *path, const SparseMatrix *matrix);
+
+/**
+ * @brief Loads a sparse matrix from the binary CSR form written by SaveSparseMatrixBinary:
+ * SPARSE_BINARY_MAGIC, rows, cols and nnz as 32-bit unsigned integers, then row_ptr,
+ * col_idx and values as 32-bit integers in host byte order.
+ * The caller is responsible for calling FreeSparseMatrix.
+ */
+cl_int LoadSparseMatrixBinary(const char *path, SparseMatrix *matrix);
+
+/**
+ * @brief Saves a sparse matrix in binary CSR form.
+ */
+cl_int SaveSparseMatrixBinary(const char *path, const SparseMatrix *matrix);
+
+/**
+ * @brief Converts a dense matrix to CSR, dropping zeros.
+ */
+cl_int DenseToSparse(const Matrix *dense, SparseMatrix *sparse);
+
+/**
+ * @brief Converts a CSR matrix to a newly allocated dense matrix.  Free it with FreeMatrix.
+ */
+cl_int SparseToDense(const SparseMatrix *sparse, Matrix *dense);
+
+/**
+ * @brief Reference sparse matrix-vector product y = A * x, split over threads by nonzeros.
+ *
+ * @param x A vector of a->shape[1] entries.
+ * @param y A vector of a->shape[0] entries.
+ * @param num_threads The number of host threads.  0 uses every online processor.
+ */
+cl_int SparseMatVec(const SparseMatrix *a, const int *x, int *y, unsigned int num_threads);
+
+/**
+ * @brief Reference sparse-dense matrix product C = A * B.  Allocates c->data; free it with FreeMatrix.
+ *
+ * @param num_threads The number of host threads.  0 uses every online processor.
+ */
+cl_int SparseMatMul(const SparseMatrix *a, const Matrix *b, Matrix *c, unsigned int num_threads);
+
+/**
+ * @brief Checks a dense result against a sparse truth without densifying it.
+ * Prints the same verdicts as CheckMatrix.
+ */
+cl_int CheckSparseMatrix(SparseMatrix *truth, Matrix *student);
+
+/**
+ * @brief Creates the row_ptr, col_idx and values device buffers straight from a CSR matrix.
+ *
+ * @param buffers The three buffers, in that order.  The caller releases them.
+ */
+cl_int OclCreateSparseBuffers(cl_context context, cl_mem_flags flags, const SparseMatrix *matrix,
+                              cl_mem buffers[3]);
+
+/**
+ * @brief Frees a sparse matrix.
+ */
+void FreeSparseMatrix(SparseMatrix *matrix);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "svm.h"
+
+OclSvmMode OclGetSvmMode(const OclDeviceProp *device, OclSvmMode requested)
+{
+#ifdef CL_VERSION_2_0
+    cl_device_svm_capabilities caps = device->svm_capabilities ? *device->svm_capabilities : 0;
+
+    if (requested >= OCL_SVM_FINE_GRAIN && (caps & CL_DEVICE_SVM_FINE_GRAIN_BUFFER))
+        return OCL_SVM_FINE_GRAIN;
+    if (requested >= OCL_SVM_COARSE_GRAIN && (caps & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER))
+        return OCL_SVM_COARSE_GRAIN;
+#endif
+    return OCL_SVM_NONE;
+}
+
+/**
+ * @brief Initializes a shared buffer descriptor without allocating.
+ */
+static void OclInitShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                          OclSvmMode requested, OclSharedBuffer *shared)
+{
+    memset(shared, 0, sizeof(*shared));
+    shared->mode = OclGetSvmMode(device, requested);
+    shared->context = context;
+    shared->queue = queue;
+}
+
+/**
+ * @brief HostAllocFn that backs a Load* call with a shared buffer.
+ * Coarse-grained SVM is returned mapped for writing so the loader can parse into it.
+ */
+static void *OclSharedAllocator(size_t bytes, void *user_data)
+{
+    OclSharedBuffer *shared = (OclSharedBuffer *)user_data;
+
+    shared->size = bytes;
+
+#ifdef CL_VERSION_2_0
+    if (shared->mode != OCL_SVM_NONE)
+    {
+        cl_svm_mem_flags flags = CL_MEM_READ_WRITE;
+        if (shared->mode == OCL_SVM_FINE_GRAIN)
+            flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+
+        shared->host_ptr = clSVMAlloc(shared->context, flags, bytes, 0);
+        if (shared->host_ptr && shared->mode == OCL_SVM_COARSE_GRAIN)
+        {
+            if (clEnqueueSVMMap(shared->queue, CL_TRUE, CL_MAP_WRITE, shared->host_ptr, bytes,
+                                0, NULL, NULL) == CL_SUCCESS)
+                shared->mapped = true;
+            else
+            {
+                clSVMFree(shared->context, shared->host_ptr);
+                shared->host_ptr = NULL;
+            }
+        }
+        if (shared->host_ptr)
+            return shared->host_ptr;
+
+        shared->mode = OCL_SVM_NONE; // The runtime refused; use the buffer path
+    }
+#endif
+
+    shared->host_ptr = malloc(bytes);
+    return shared->host_ptr;
+}
+
+cl_int OclAllocShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                      OclSvmMode requested, size_t size, OclSharedBuffer *shared)
+{
+    cl_int status = CL_SUCCESS;
+
+    OclInitShared(context, queue, device, requested, shared);
+
+    if (!OclSharedAllocator(size, shared))
+        return CL_OUT_OF_HOST_MEMORY;
+
+    if (shared->mode == OCL_SVM_NONE)
+    {
+        shared->buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, size, NULL, &status);
+        if (status != CL_SUCCESS)
+            OclFreeShared(shared);
+    }
+    else if (shared->mapped)
+    {
+        // Outputs start out owned by the device.
+        status = OclSyncSharedToDevice(shared);
+    }
+
+    return status;
+}
+
+/**
+ * @brief Finishes a Load*WithAllocator call into a shared buffer.
+ */
+static cl_int OclFinishLoadShared(cl_int status, OclSharedBuffer *shared)
+{
+    if (status == CL_SUCCESS)
+        status = OclSyncSharedToDevice(shared);
+    if (status != CL_SUCCESS)
+        OclFreeShared(shared);
+
+    return status;
+}
+
+cl_int LoadMatrixShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                        OclSvmMode requested, const char *path, Matrix *matrix,
+                        OclSharedBuffer *shared)
+{
+    OclInitShared(context, queue, device, requested, shared);
+    cl_int status = LoadMatrixWithAllocator(path, matrix, OclSharedAllocator, shared);
+    return OclFinishLoadShared(status, shared);
+}
+
+cl_int LoadImgShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                     OclSvmMode requested, const char *path, Image *img, OclSharedBuffer *shared)
+{
+    OclInitShared(context, queue, device, requested, shared);
+    cl_int status = LoadImgWithAllocator(path, img, OclSharedAllocator, shared);
+    return OclFinishLoadShared(status, shared);
+}
+
+cl_int LoadImgRawShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                        OclSvmMode requested, const char *path, Image *img, OclSharedBuffer *shared)
+{
+    OclInitShared(context, queue, device, requested, shared);
+    cl_int status = LoadImgRawWithAllocator(path, img, OclSharedAllocator, shared);
+    return OclFinishLoadShared(status, shared);
+}
+
+cl_int OclSetKernelArgShared(cl_kernel kernel, cl_uint arg_index, const OclSharedBuffer *shared)
+{
+#ifdef CL_VERSION_2_0
+    if (shared->mode != OCL_SVM_NONE)
+        return clSetKernelArgSVMPointer(kernel, arg_index, shared->host_ptr);
+#endif
+    return clSetKernelArg(kernel, arg_index, sizeof(cl_mem), &shared->buffer);
+}
+
+cl_int OclSyncSharedToDevice(OclSharedBuffer *shared)
+{
+    cl_int status = CL_SUCCESS;
+
+    switch (shared->mode)
+    {
+    case OCL_SVM_NONE:
+        if (!shared->buffer)
+            shared->buffer = clCreateBuffer(shared->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+                                            shared->size, shared->host_ptr, &status);
+        else
+            status = clEnqueueWriteBuffer(shared->queue, shared->buffer, CL_TRUE, 0, shared->size,
+                                          shared->host_ptr, 0, NULL, NULL);
+        break;
+#ifdef CL_VERSION_2_0
+    case OCL_SVM_COARSE_GRAIN:
+        if (shared->mapped)
+        {
+            status = clEnqueueSVMUnmap(shared->queue, shared->host_ptr, 0, NULL, NULL);
+            if (status == CL_SUCCESS)
+                shared->mapped = false;
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return status;
+}
+
+cl_int OclSyncSharedToHost(OclSharedBuffer *shared)
+{
+    cl_int status = CL_SUCCESS;
+
+    switch (shared->mode)
+    {
+    case OCL_SVM_NONE:
+        status = clEnqueueReadBuffer(shared->queue, shared->buffer, CL_TRUE, 0, shared->size,
+                                     shared->host_ptr, 0, NULL, NULL);
+        break;
+#ifdef CL_VERSION_2_0
+    case OCL_SVM_COARSE_GRAIN:
+        if (!shared->mapped)
+        {
+            status = clEnqueueSVMMap(shared->queue, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                     shared->host_ptr, shared->size, 0, NULL, NULL);
+            if (status == CL_SUCCESS)
+                shared->mapped = true;
+        }
+        break;
+#endif
+    default:
+        status = clFinish(shared->queue); // Fine-grained data is coherent once the kernels are done
+        break;
+    }
+
+    return status;
+}
+
+cl_int OclFreeShared(OclSharedBuffer *shared)
+{
+    if (shared->mode == OCL_SVM_NONE)
+    {
+        if (shared->buffer)
+            clReleaseMemObject(shared->buffer);
+        free(shared->host_ptr);
+    }
+#ifdef CL_VERSION_2_0
+    else if (shared->host_ptr)
+    {
+        if (shared->mapped)
+            clEnqueueSVMUnmap(shared->queue, shared->host_ptr, 0, NULL, NULL);
+        clFinish(shared->queue);
+        clSVMFree(shared->context, shared->host_ptr);
+    }
+#endif
+
+    shared->host_ptr = NULL;
+    shared->buffer = NULL;
+    shared->mapped = false;
+
+    return CL_SUCCESS;
+}
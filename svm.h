@@ -0,0 +1,99 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "device.h"
+#include "img.h"
+#include "matrix.h"
+
+/**
+ * @brief How a shared allocation is backed.  Ordered from least to most capable.
+ */
+typedef enum _OclSvmMode
+{
+    OCL_SVM_NONE,         // Host memory plus a cl_mem copy (the classic buffer path).
+    OCL_SVM_COARSE_GRAIN, // clSVMAlloc; the host maps it around its own accesses.
+    OCL_SVM_FINE_GRAIN,   // clSVMAlloc with CL_MEM_SVM_FINE_GRAIN_BUFFER; no maps needed.
+} OclSvmMode;
+
+/**
+ * @brief Host data that a kernel can read in place when the device supports SVM.
+ * The Matrix or Image loaded into it points at host_ptr.
+ */
+typedef struct _OclSharedBuffer
+{
+    OclSvmMode mode;
+    cl_context context;
+    cl_command_queue queue;
+    void *host_ptr;
+    cl_mem buffer; // OCL_SVM_NONE only.
+    size_t size;
+    bool mapped;   // OCL_SVM_COARSE_GRAIN only.
+} OclSharedBuffer;
+
+/**
+ * @brief Returns the most capable mode the device supports that does not exceed requested.
+ */
+OclSvmMode OclGetSvmMode(const OclDeviceProp *device, OclSvmMode requested);
+
+/**
+ * @brief Allocates a shared buffer, e.g. for a kernel's output.
+ * Falls back to OCL_SVM_NONE if the device or runtime cannot provide the requested mode.
+ * The caller is responsible for calling OclFreeShared.
+ *
+ * @return CL_SUCCESS if and only if the buffer is allocated.
+ */
+cl_int OclAllocShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                      OclSvmMode requested, size_t size, OclSharedBuffer *shared);
+
+/**
+ * @brief Loads a matrix directly into a shared buffer and makes it visible to the device.
+ * The caller is responsible for calling OclFreeShared, not FreeMatrix.
+ *
+ * @return CL_SUCCESS if and only if the matrix is loaded and visible to the device.
+ */
+cl_int LoadMatrixShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                        OclSvmMode requested, const char *path, Matrix *matrix,
+                        OclSharedBuffer *shared);
+
+/**
+ * @brief As LoadMatrixShared, for a PPM image read by LoadImg.
+ */
+cl_int LoadImgShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                     OclSvmMode requested, const char *path, Image *img, OclSharedBuffer *shared);
+
+/**
+ * @brief As LoadMatrixShared, for a raw image read by LoadImgRaw.
+ */
+cl_int LoadImgRawShared(cl_context context, cl_command_queue queue, const OclDeviceProp *device,
+                        OclSvmMode requested, const char *path, Image *img, OclSharedBuffer *shared);
+
+/**
+ * @brief Passes a shared buffer as a kernel argument, as an SVM pointer or as a cl_mem.
+ */
+cl_int OclSetKernelArgShared(cl_kernel kernel, cl_uint arg_index, const OclSharedBuffer *shared);
+
+/**
+ * @brief Makes host writes visible to the device.  Call before enqueueing kernels that read the data.
+ * Unmaps coarse-grained SVM and writes the buffer copy; does nothing for fine-grained SVM.
+ */
+cl_int OclSyncSharedToDevice(OclSharedBuffer *shared);
+
+/**
+ * @brief Makes device writes visible to the host.  Blocks until the queue's prior work completes.
+ * Maps coarse-grained SVM and reads back the buffer copy.
+ */
+cl_int OclSyncSharedToHost(OclSharedBuffer *shared);
+
+/**
+ * @brief Frees a shared buffer.  The caller must ensure no enqueued command still uses it.
+ */
+cl_int OclFreeShared(OclSharedBuffer *shared);
+
+#ifdef __cplusplus
+}
+#endif
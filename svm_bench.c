@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "svm.h"
+#include "timing.h"
+
+#define BENCH_WARMUP 3
+#define BENCH_ITERATIONS 30
+
+static const char *scale_source =
+    "__kernel void scale(__global int *data)\n"
+    "{\n"
+    "    data[get_global_id(0)] *= 2;\n"
+    "}\n";
+
+typedef struct _BenchJob
+{
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    const OclDeviceProp *device;
+    OclSvmMode mode;
+    const char *path;
+    OclSharedBuffer shared; // Loaded once for RunTransfer.
+    size_t global_size;
+} BenchJob;
+
+/**
+ * @brief Sync to the device, run and sync back: the part the copy-free modes can save.
+ * The matrix is already loaded, so file parsing and allocation are not timed.
+ */
+static cl_int RunTransfer(void *user_data)
+{
+    BenchJob *job = (BenchJob *)user_data;
+    cl_int status;
+
+    status = OclSyncSharedToDevice(&job->shared);
+    if (status == CL_SUCCESS)
+        status = clEnqueueNDRangeKernel(job->queue, job->kernel, 1, NULL, &job->global_size, NULL,
+                                        0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = OclSyncSharedToHost(&job->shared);
+
+    return status;
+}
+
+/**
+ * @brief Load, run and read back once, the way a lab would for each input.
+ */
+static cl_int RunOnce(void *user_data)
+{
+    BenchJob *job = (BenchJob *)user_data;
+    OclSharedBuffer shared;
+    Matrix matrix;
+    cl_int status;
+
+    status = LoadMatrixShared(job->context, job->queue, job->device, job->mode, job->path,
+                              &matrix, &shared);
+    if (status != CL_SUCCESS)
+        return status;
+
+    size_t global_size = (size_t)matrix.shape[0] * matrix.shape[1];
+    status = OclSetKernelArgShared(job->kernel, 0, &shared);
+    if (status == CL_SUCCESS)
+        status = clEnqueueNDRangeKernel(job->queue, job->kernel, 1, NULL, &global_size, NULL,
+                                        0, NULL, NULL);
+    if (status == CL_SUCCESS)
+        status = OclSyncSharedToHost(&shared);
+
+    OclFreeShared(&shared);
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    OclPlatformProp *platforms = NULL;
+    cl_uint num_platforms;
+    cl_device_id device_id;
+    int platform_index, device_index;
+    cl_int status;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s MATRIX\n", argv[0]);
+        return 1;
+    }
+
+    status = OclGetDeviceInfoWithFallback(&device_id, &platform_index, &device_index, OCL_DEVICE_TYPE);
+    if (status == CL_SUCCESS)
+        status = OclFindPlatforms((const OclPlatformProp **)&platforms, &num_platforms);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to find a device (%d)\n", status);
+        return 1;
+    }
+    const OclDeviceProp *device = &platforms[platform_index].devices[device_index];
+
+    cl_context context = clCreateContext(NULL, 1, &device_id, NULL, NULL, &status);
+    cl_command_queue queue = OclCreateCommandQueue(context, device_id, 0, &status);
+    cl_program program = clCreateProgramWithSource(context, 1, &scale_source, NULL, &status);
+    status = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+    cl_kernel kernel = clCreateKernel(program, "scale", &status);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to build the benchmark kernel (%d)\n", status);
+        return 1;
+    }
+
+    const char *labels[] = {"Buffer copy", "Coarse-grained SVM", "Fine-grained SVM"};
+    for (int mode = OCL_SVM_NONE; mode <= OCL_SVM_FINE_GRAIN; mode++)
+    {
+        if (OclGetSvmMode(device, (OclSvmMode)mode) != mode)
+        {
+            printf("%s: not supported by this device\n", labels[mode]);
+            continue;
+        }
+
+        BenchJob job = {context, queue, kernel, device, (OclSvmMode)mode, argv[1], {0}, 0};
+        OclTimingConfig config = {BENCH_WARMUP, BENCH_ITERATIONS, 0, 0};
+        OclTimingStats stats;
+        Matrix matrix;
+        char label[64];
+
+        // Load once so the timed region is only the transfers and the kernel.
+        status = LoadMatrixShared(context, queue, device, (OclSvmMode)mode, argv[1], &matrix, &job.shared);
+        if (status == CL_SUCCESS)
+        {
+            job.global_size = (size_t)matrix.shape[0] * matrix.shape[1];
+            config.bytes = 2 * job.shared.size; // To the device and back
+            status = OclSetKernelArgShared(kernel, 0, &job.shared);
+            if (status == CL_SUCCESS)
+                status = OclSyncSharedToHost(&job.shared);
+            if (status == CL_SUCCESS)
+                status = OclTimeHost(RunTransfer, &job, &config, &stats);
+            OclFreeShared(&job.shared);
+        }
+        if (status != CL_SUCCESS)
+        {
+            printf("%s: failed (%d)\n", labels[mode], status);
+            continue;
+        }
+        snprintf(label, sizeof(label), "%s (sync + kernel)", labels[mode]);
+        OclPrintTimingStats(label, &stats);
+
+        config.bytes = 0;
+        status = OclTimeHost(RunOnce, &job, &config, &stats);
+        if (status != CL_SUCCESS)
+        {
+            printf("%s: end to end failed (%d)\n", labels[mode], status);
+            continue;
+        }
+        snprintf(label, sizeof(label), "%s (end to end)", labels[mode]);
+        OclPrintTimingStats(label, &stats);
+    }
+
+    clReleaseKernel(kernel);
+    clReleaseProgram(program);
+    clReleaseCommandQueue(queue);
+    clReleaseContext(context);
+    for (cl_uint i = 0; i < num_platforms; i++)
+        OclFreePlatformProp(&platforms[i]);
+    free(platforms);
+
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "device.h"
+#include "taskgraph.h"
+
+#define OCL_GRAPH_INITIAL_CAPACITY 16
+
+cl_int OclCreateTaskGraph(cl_context context, cl_device_id device_id, cl_uint num_queues,
+                          OclTaskGraph *graph)
+{
+    cl_int status = CL_SUCCESS;
+
+    memset(graph, 0, sizeof(*graph));
+
+    if (num_queues == 0 || num_queues > OCL_GRAPH_MAX_QUEUES)
+        return CL_INVALID_VALUE;
+
+    graph->context = context;
+
+    for (cl_uint i = 0; i < num_queues; i++)
+    {
+        graph->queues[i] = OclCreateCommandQueue(context, device_id, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE,
+                                                 &status);
+        if (status == CL_INVALID_QUEUE_PROPERTIES)
+            // Explicit wait lists keep the schedule correct on in-order queues too.
+            graph->queues[i] = OclCreateCommandQueue(context, device_id, 0, &status);
+        if (status != CL_SUCCESS)
+        {
+            OclReleaseTaskGraph(graph);
+            return status;
+        }
+        graph->num_queues++;
+    }
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Appends a task, checking that its dependencies already exist.
+ */
+static cl_int OclAddTask(OclTaskGraph *graph, const OclTask *task, cl_uint num_deps,
+                         const cl_uint *deps, cl_uint *id)
+{
+    if (graph->built || num_deps > OCL_TASK_MAX_DEPS)
+        return CL_INVALID_OPERATION;
+
+    for (cl_uint i = 0; i < num_deps; i++)
+        if (deps[i] >= graph->num_tasks)
+            return CL_INVALID_EVENT_WAIT_LIST;
+
+    if (graph->num_tasks == graph->capacity)
+    {
+        cl_uint capacity = graph->capacity ? graph->capacity * 2 : OCL_GRAPH_INITIAL_CAPACITY;
+        OclTask *tasks = (OclTask *)realloc(graph->tasks, capacity * sizeof(OclTask));
+        if (!tasks)
+            return CL_OUT_OF_HOST_MEMORY;
+        graph->tasks = tasks;
+        graph->capacity = capacity;
+    }
+
+    OclTask *added = &graph->tasks[graph->num_tasks];
+    *added = *task;
+    added->num_deps = num_deps;
+    if (num_deps)
+        memcpy(added->deps, deps, num_deps * sizeof(cl_uint));
+    added->queue = 0;
+    added->event = NULL;
+
+    if (id)
+        *id = graph->num_tasks;
+    graph->num_tasks++;
+
+    return CL_SUCCESS;
+}
+
+cl_int OclAddWriteTask(OclTaskGraph *graph, cl_mem buffer, size_t offset, size_t size,
+                       const void *host_ptr, cl_uint num_deps, const cl_uint *deps, cl_uint *id)
+{
+    OclTask task;
+
+    memset(&task, 0, sizeof(task));
+    task.type = OCL_TASK_WRITE;
+    task.buffer = buffer;
+    task.offset = offset;
+    task.size = size;
+    task.host_ptr = (void *)host_ptr;
+
+    return OclAddTask(graph, &task, num_deps, deps, id);
+}
+
+cl_int OclAddKernelTask(OclTaskGraph *graph, cl_kernel kernel, cl_uint work_dim,
+                        const size_t *global_size, const size_t *local_size,
+                        cl_uint num_deps, const cl_uint *deps, cl_uint *id)
+{
+    OclTask task;
+
+    if (work_dim == 0 || work_dim > 3)
+        return CL_INVALID_VALUE;
+
+    memset(&task, 0, sizeof(task));
+    task.type = OCL_TASK_KERNEL;
+    task.kernel = kernel;
+    task.work_dim = work_dim;
+    memcpy(task.global_size, global_size, work_dim * sizeof(size_t));
+    if (local_size)
+    {
+        memcpy(task.local_size, local_size, work_dim * sizeof(size_t));
+        task.has_local_size = true;
+    }
+
+    return OclAddTask(graph, &task, num_deps, deps, id);
+}
+
+cl_int OclAddReadTask(OclTaskGraph *graph, cl_mem buffer, size_t offset, size_t size,
+                      void *host_ptr, cl_uint num_deps, const cl_uint *deps, cl_uint *id)
+{
+    OclTask task;
+
+    memset(&task, 0, sizeof(task));
+    task.type = OCL_TASK_READ;
+    task.buffer = buffer;
+    task.offset = offset;
+    task.size = size;
+    task.host_ptr = host_ptr;
+
+    return OclAddTask(graph, &task, num_deps, deps, id);
+}
+
+cl_int OclAddHostTask(OclTaskGraph *graph, OclHostTaskFn fn, void *user_data,
+                      cl_uint num_deps, const cl_uint *deps, cl_uint *id)
+{
+    OclTask task;
+
+    memset(&task, 0, sizeof(task));
+    task.type = OCL_TASK_HOST;
+    task.fn = fn;
+    task.user_data = user_data;
+
+    return OclAddTask(graph, &task, num_deps, deps, id);
+}
+
+cl_int OclBuildTaskGraph(OclTaskGraph *graph)
+{
+    if (graph->built)
+        return CL_SUCCESS;
+
+    bool *continued = (bool *)calloc(graph->num_tasks ? graph->num_tasks : 1, sizeof(bool));
+    if (!continued)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    cl_uint next_queue = 0;
+    for (cl_uint t = 0; t < graph->num_tasks; t++)
+    {
+        OclTask *task = &graph->tasks[t];
+
+        if (task->num_deps > 0 && !continued[task->deps[0]])
+        {
+            // Extend the dependency's chain; its queue already orders the two.
+            continued[task->deps[0]] = true;
+            task->queue = graph->tasks[task->deps[0]].queue;
+        }
+        else
+        {
+            // A new branch.
+            task->queue = next_queue;
+            next_queue = (next_queue + 1) % graph->num_queues;
+        }
+    }
+
+    free(continued);
+    graph->built = true;
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Runs a host task once its marker completes, then releases its dependents.
+ */
+static void CL_CALLBACK OclRunHostTask(cl_event marker, cl_int marker_status, void *user_data)
+{
+    OclTask *task = (OclTask *)user_data;
+
+    if (marker_status == CL_COMPLETE)
+        task->fn(task->user_data);
+
+    // A negative status propagates the failure to the task's dependents.
+    clSetUserEventStatus(task->event, marker_status == CL_COMPLETE ? CL_COMPLETE : marker_status);
+}
+
+/**
+ * @brief Enqueues a host task.  Its completion is a user event set from a callback on a marker
+ * that waits for the task's dependencies, so enqueueing never blocks.
+ */
+static cl_int OclEnqueueHostTask(OclTaskGraph *graph, OclTask *task, cl_uint num_waits,
+                                 const cl_event *waits)
+{
+    cl_event marker;
+    cl_int status;
+
+    task->event = clCreateUserEvent(graph->context, &status);
+    if (status != CL_SUCCESS)
+        return status;
+
+    if (num_waits == 0)
+    {
+        // A marker with an empty wait list would wait for the whole queue; run now instead.
+        task->fn(task->user_data);
+        return clSetUserEventStatus(task->event, CL_COMPLETE);
+    }
+
+    // On failure the user event must still complete, or waiting on it would never return.
+    status = clEnqueueMarkerWithWaitList(graph->queues[task->queue], num_waits, waits, &marker);
+    if (status != CL_SUCCESS)
+    {
+        clSetUserEventStatus(task->event, status);
+        return status;
+    }
+
+    status = clSetEventCallback(marker, CL_COMPLETE, OclRunHostTask, task);
+    clReleaseEvent(marker);
+    if (status != CL_SUCCESS)
+        clSetUserEventStatus(task->event, status);
+
+    return status;
+}
+
+cl_int OclRunTaskGraph(OclTaskGraph *graph)
+{
+    cl_event waits[OCL_TASK_MAX_DEPS];
+    cl_int status = CL_SUCCESS;
+
+    if (!graph->built)
+        return CL_INVALID_OPERATION;
+
+    cl_uint t;
+    for (t = 0; t < graph->num_tasks && status == CL_SUCCESS; t++)
+    {
+        OclTask *task = &graph->tasks[t];
+        cl_command_queue queue = graph->queues[task->queue];
+
+        if (task->event)
+        {
+            clReleaseEvent(task->event);
+            task->event = NULL;
+        }
+
+        for (cl_uint d = 0; d < task->num_deps; d++)
+            waits[d] = graph->tasks[task->deps[d]].event;
+
+        switch (task->type)
+        {
+        case OCL_TASK_WRITE:
+            status = clEnqueueWriteBuffer(queue, task->buffer, CL_FALSE, task->offset, task->size,
+                                          task->host_ptr, task->num_deps, waits, &task->event);
+            break;
+        case OCL_TASK_KERNEL:
+            status = clEnqueueNDRangeKernel(queue, task->kernel, task->work_dim, NULL,
+                                            task->global_size,
+                                            task->has_local_size ? task->local_size : NULL,
+                                            task->num_deps, waits, &task->event);
+            break;
+        case OCL_TASK_READ:
+            status = clEnqueueReadBuffer(queue, task->buffer, CL_FALSE, task->offset, task->size,
+                                         task->host_ptr, task->num_deps, waits, &task->event);
+            break;
+        case OCL_TASK_HOST:
+            status = OclEnqueueHostTask(graph, task, task->num_deps, waits);
+            break;
+        }
+    }
+
+    for (cl_uint q = 0; q < graph->num_queues; q++)
+        clFlush(graph->queues[q]);
+
+    // Wait for everything that was enqueued, even after a failure, so no command outlives the run.
+    for (cl_uint i = 0; i < t; i++)
+    {
+        if (!graph->tasks[i].event)
+            continue;
+        cl_int wait_status = clWaitForEvents(1, &graph->tasks[i].event);
+        if (status == CL_SUCCESS)
+            status = wait_status;
+    }
+
+    return status;
+}
+
+cl_int OclReleaseTaskGraph(OclTaskGraph *graph)
+{
+    for (cl_uint t = 0; t < graph->num_tasks; t++)
+        if (graph->tasks[t].event)
+            clReleaseEvent(graph->tasks[t].event);
+    free(graph->tasks);
+    graph->tasks = NULL;
+    graph->num_tasks = 0;
+    graph->capacity = 0;
+
+    for (cl_uint q = 0; q < graph->num_queues; q++)
+        clReleaseCommandQueue(graph->queues[q]);
+    graph->num_queues = 0;
+
+    return CL_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#define OCL_TASK_MAX_DEPS 8
+#define OCL_GRAPH_MAX_QUEUES 8
+
+typedef enum _OclTaskType
+{
+    OCL_TASK_WRITE,
+    OCL_TASK_KERNEL,
+    OCL_TASK_READ,
+    OCL_TASK_HOST,
+} OclTaskType;
+
+/**
+ * @brief A host callback node.  Runs on an OpenCL runtime thread once its dependencies complete.
+ */
+typedef void (*OclHostTaskFn)(void *user_data);
+
+/**
+ * @brief A node of a task graph.  Only the fields for its type are used.
+ */
+typedef struct _OclTask
+{
+    OclTaskType type;
+
+    // OCL_TASK_WRITE and OCL_TASK_READ
+    cl_mem buffer;
+    size_t offset;
+    size_t size;
+    void *host_ptr;
+
+    // OCL_TASK_KERNEL
+    cl_kernel kernel;
+    cl_uint work_dim;
+    size_t global_size[3];
+    size_t local_size[3];
+    bool has_local_size;
+
+    // OCL_TASK_HOST
+    OclHostTaskFn fn;
+    void *user_data;
+
+    cl_uint num_deps;
+    cl_uint deps[OCL_TASK_MAX_DEPS];
+    cl_uint queue;  // Assigned by OclBuildTaskGraph.
+    cl_event event; // Completion of the task's last run.
+} OclTask;
+
+/**
+ * @brief A dependency graph of transfers, kernels and host callbacks.
+ * Tasks may only depend on tasks added before them, so insertion order is a valid schedule.
+ */
+typedef struct _OclTaskGraph
+{
+    cl_context context;
+    cl_uint num_queues;
+    cl_command_queue queues[OCL_GRAPH_MAX_QUEUES];
+    cl_uint num_tasks;
+    cl_uint capacity;
+    OclTask *tasks;
+    bool built;
+} OclTaskGraph;
+
+/**
+ * @brief Creates an empty task graph and the out-of-order queues it is scheduled on.
+ * Falls back to in-order queues if the device does not support out-of-order execution.
+ * The caller is responsible for calling OclReleaseTaskGraph.
+ *
+ * @param num_queues The number of queues independent branches are spread over, up to OCL_GRAPH_MAX_QUEUES.
+ *
+ * @return CL_SUCCESS if and only if every queue is created.
+ */
+cl_int OclCreateTaskGraph(cl_context context, cl_device_id device_id, cl_uint num_queues,
+                          OclTaskGraph *graph);
+
+/**
+ * @brief Adds a host to device copy of size bytes from host_ptr to buffer at offset.
+ *
+ * @param deps The IDs of the tasks this one waits for.
+ * @param id The ID of the new task.
+ *
+ * @return CL_SUCCESS if and only if the task is added.
+ */
+cl_int OclAddWriteTask(OclTaskGraph *graph, cl_mem buffer, size_t offset, size_t size,
+                       const void *host_ptr, cl_uint num_deps, const cl_uint *deps, cl_uint *id);
+
+/**
+ * @brief Adds a kernel launch.  The kernel's arguments must be set before every run.
+ * local_size may be NULL to let the runtime choose.
+ */
+cl_int OclAddKernelTask(OclTaskGraph *graph, cl_kernel kernel, cl_uint work_dim,
+                        const size_t *global_size, const size_t *local_size,
+                        cl_uint num_deps, const cl_uint *deps, cl_uint *id);
+
+/**
+ * @brief Adds a device to host copy of size bytes from buffer at offset to host_ptr.
+ */
+cl_int OclAddReadTask(OclTaskGraph *graph, cl_mem buffer, size_t offset, size_t size,
+                      void *host_ptr, cl_uint num_deps, const cl_uint *deps, cl_uint *id);
+
+/**
+ * @brief Adds a host callback.
+ */
+cl_int OclAddHostTask(OclTaskGraph *graph, OclHostTaskFn fn, void *user_data,
+                      cl_uint num_deps, const cl_uint *deps, cl_uint *id);
+
+/**
+ * @brief Assigns tasks to queues.  A task continues on its first dependency's queue unless
+ * a sibling already did, so chains stay on one queue and independent branches get their own.
+ * No tasks can be added after the graph is built.
+ *
+ * @return CL_SUCCESS if and only if the graph is ready to run.
+ */
+cl_int OclBuildTaskGraph(OclTaskGraph *graph);
+
+/**
+ * @brief Enqueues every task of a built graph with its dependencies as event wait lists,
+ * then waits for the whole graph.  A graph can be run any number of times.
+ *
+ * @return CL_SUCCESS if and only if every task completes.
+ */
+cl_int OclRunTaskGraph(OclTaskGraph *graph);
+
+/**
+ * @brief Releases a task graph's events and queues.
+ *
+ * @return CL_SUCCESS if and only if the graph is successfully released.
+ */
+cl_int OclReleaseTaskGraph(OclTaskGraph *graph);
+
+#ifdef __cplusplus
+}
+#endif
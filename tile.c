@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tile.h"
+
+/**
+ * @brief Device buffers for one tile in flight.
+ */
+typedef struct _OclTileSlot
+{
+    cl_mem inputs[2];
+    cl_mem output;
+    cl_event done; // Completion of the slot's last readback.
+} OclTileSlot;
+
+/**
+ * @brief Computes the device footprint of a rows x cols tile.
+ *
+ * @param largest The size of the largest single buffer of the tile.
+ *
+ * @return The total number of device bytes used by the tile.
+ */
+static size_t OclTileBytes(const OclTilePlan *plan, size_t rows, size_t cols, size_t *largest)
+{
+    size_t out = rows * cols * plan->elem_size;
+    size_t in0, in1 = 0;
+
+    if (plan->kind == OCL_TILE_GEMM)
+    {
+        in0 = rows * plan->inner * plan->elem_size;
+        in1 = plan->inner * cols * plan->elem_size;
+    }
+    else
+    {
+        size_t in_rows = rows + 2 * (size_t)plan->halo;
+        size_t in_cols = cols + 2 * (size_t)plan->halo;
+        if (in_rows > plan->shape[0])
+            in_rows = plan->shape[0];
+        if (in_cols > plan->shape[1])
+            in_cols = plan->shape[1];
+        in0 = in_rows * in_cols * plan->elem_size;
+    }
+
+    *largest = out;
+    if (in0 > *largest)
+        *largest = in0;
+    if (in1 > *largest)
+        *largest = in1;
+
+    return out + in0 + in1;
+}
+
+/**
+ * @brief Halves a tile edge, keeping it a multiple of OCL_TILE_ALIGN while it is large enough.
+ */
+static unsigned int OclHalveEdge(unsigned int edge)
+{
+    unsigned int half = (edge + 1) / 2;
+    if (half > OCL_TILE_ALIGN)
+        half = (half + OCL_TILE_ALIGN - 1) / OCL_TILE_ALIGN * OCL_TILE_ALIGN;
+    return half;
+}
+
+cl_int OclPlanTiles(const OclDeviceProp *device, OclTileKind kind, const unsigned int shape[2],
+                    unsigned int inner, unsigned int halo, size_t elem_size,
+                    size_t reserved_bytes, OclTilePlan *plan)
+{
+    if (shape[0] == 0 || shape[1] == 0 || elem_size == 0)
+        return CL_INVALID_VALUE;
+    if (kind == OCL_TILE_GEMM && inner == 0)
+        return CL_INVALID_VALUE;
+
+    plan->kind = kind;
+    plan->shape[0] = shape[0];
+    plan->shape[1] = shape[1];
+    plan->inner = kind == OCL_TILE_GEMM ? inner : 0;
+    plan->halo = kind == OCL_TILE_STENCIL ? halo : 0;
+    plan->elem_size = elem_size;
+    plan->num_tiles = 0;
+    plan->tiles = NULL;
+
+    if (device->max_constant_buffer_size && reserved_bytes > *device->max_constant_buffer_size)
+        return CL_OUT_OF_RESOURCES; // The resident data cannot be bound as __constant
+
+    cl_ulong global_mem = *device->global_mem_size;
+    cl_ulong usable = global_mem - global_mem / OCL_TILE_HEADROOM;
+    if (reserved_bytes >= usable)
+        return CL_OUT_OF_RESOURCES;
+    usable -= reserved_bytes;
+
+    cl_ulong max_alloc = device->max_mem_alloc_size ? *device->max_mem_alloc_size : global_mem / 4;
+
+    unsigned int rows = shape[0];
+    unsigned int cols = shape[1];
+    unsigned int num_buffers = 1;
+    size_t largest;
+    size_t bytes = OclTileBytes(plan, rows, cols, &largest);
+
+    // Tiles only pay off if more than one can be in flight.
+    if (bytes > usable || largest > max_alloc)
+    {
+        num_buffers = OCL_TILE_BUFFERS;
+        while (bytes * num_buffers > usable || largest > max_alloc)
+        {
+            if (rows == 1 && cols == 1)
+                return CL_OUT_OF_RESOURCES; // inner or halo alone is too large
+
+            if (rows >= cols)
+                rows = OclHalveEdge(rows);
+            else
+                cols = OclHalveEdge(cols);
+
+            bytes = OclTileBytes(plan, rows, cols, &largest);
+        }
+    }
+
+    plan->tile_shape[0] = rows;
+    plan->tile_shape[1] = cols;
+    plan->tile_bytes = bytes;
+    plan->num_buffers = num_buffers;
+
+    unsigned int tile_rows = (shape[0] + rows - 1) / rows;
+    unsigned int tile_cols = (shape[1] + cols - 1) / cols;
+
+    plan->tiles = (OclTile *)malloc((size_t)tile_rows * tile_cols * sizeof(OclTile));
+    if (!plan->tiles)
+        return CL_OUT_OF_HOST_MEMORY;
+    plan->num_tiles = tile_rows * tile_cols;
+
+    OclTile *tile = plan->tiles;
+    for (unsigned int r = 0; r < shape[0]; r += rows)
+    {
+        for (unsigned int c = 0; c < shape[1]; c += cols, tile++)
+        {
+            tile->origin[0] = r;
+            tile->origin[1] = c;
+            tile->shape[0] = r + rows > shape[0] ? shape[0] - r : rows;
+            tile->shape[1] = c + cols > shape[1] ? shape[1] - c : cols;
+
+            unsigned int in_r0 = r > plan->halo ? r - plan->halo : 0;
+            unsigned int in_c0 = c > plan->halo ? c - plan->halo : 0;
+            unsigned int in_r1 = r + tile->shape[0] + plan->halo;
+            unsigned int in_c1 = c + tile->shape[1] + plan->halo;
+            if (in_r1 > shape[0])
+                in_r1 = shape[0];
+            if (in_c1 > shape[1])
+                in_c1 = shape[1];
+
+            tile->in_origin[0] = in_r0;
+            tile->in_origin[1] = in_c0;
+            tile->in_shape[0] = in_r1 - in_r0;
+            tile->in_shape[1] = in_c1 - in_c0;
+        }
+    }
+
+    return CL_SUCCESS;
+}
+
+/**
+ * @brief Streams every tile of a plan through the device.
+ * Each slot's uploads wait on the slot's previous readback, so up to
+ * plan->num_buffers tiles are in flight on an out-of-order or multi-engine queue.
+ *
+ * @param inputs Host inputs.  {A, B} for OCL_TILE_GEMM, {image} for OCL_TILE_STENCIL.
+ * @param output Host output, densely packed with plan->shape.
+ */
+static cl_int OclRunTiles(cl_context context, cl_command_queue queue, const OclTilePlan *plan,
+                          const int *const *inputs, int *output,
+                          OclTileLaunchFn launch, void *user_data)
+{
+    OclTileSlot slots[OCL_TILE_BUFFERS] = {0};
+    size_t es = plan->elem_size;
+    size_t t0 = plan->tile_shape[0];
+    size_t t1 = plan->tile_shape[1];
+    size_t k = plan->inner;
+    size_t in_bytes[2] = {0, 0};
+    cl_uint num_inputs;
+    cl_int status = CL_SUCCESS;
+
+    if (plan->kind == OCL_TILE_GEMM)
+    {
+        num_inputs = 2;
+        in_bytes[0] = t0 * k * es;
+        in_bytes[1] = k * t1 * es;
+    }
+    else
+    {
+        size_t in_rows = t0 + 2 * (size_t)plan->halo;
+        size_t in_cols = t1 + 2 * (size_t)plan->halo;
+        if (in_rows > plan->shape[0])
+            in_rows = plan->shape[0];
+        if (in_cols > plan->shape[1])
+            in_cols = plan->shape[1];
+        num_inputs = 1;
+        in_bytes[0] = in_rows * in_cols * es;
+    }
+
+    for (unsigned int s = 0; s < plan->num_buffers && status == CL_SUCCESS; s++)
+    {
+        for (cl_uint i = 0; i < num_inputs && status == CL_SUCCESS; i++)
+            slots[s].inputs[i] = clCreateBuffer(context, CL_MEM_READ_ONLY, in_bytes[i], NULL, &status);
+        if (status == CL_SUCCESS)
+            slots[s].output = clCreateBuffer(context, CL_MEM_WRITE_ONLY, t0 * t1 * es, NULL, &status);
+    }
+
+    size_t host_pitch = plan->shape[1] * es;
+    size_t zero[3] = {0, 0, 0};
+
+    for (unsigned int t = 0; t < plan->num_tiles && status == CL_SUCCESS; t++)
+    {
+        const OclTile *tile = &plan->tiles[t];
+        OclTileSlot *slot = &slots[t % plan->num_buffers];
+        cl_uint num_reuse = slot->done ? 1 : 0;
+        cl_event writes[2] = {NULL, NULL};
+        cl_event kernel_done = NULL;
+
+        if (plan->kind == OCL_TILE_GEMM)
+        {
+            // The A band is contiguous in row-major order.
+            status = clEnqueueWriteBuffer(queue, slot->inputs[0], CL_FALSE, 0,
+                                          tile->shape[0] * k * es,
+                                          (const char *)inputs[0] + tile->origin[0] * k * es,
+                                          num_reuse, &slot->done, &writes[0]);
+            if (status == CL_SUCCESS)
+            {
+                size_t host_origin[3] = {tile->origin[1] * es, 0, 0};
+                size_t region[3] = {tile->shape[1] * es, k, 1};
+                status = clEnqueueWriteBufferRect(queue, slot->inputs[1], CL_FALSE, zero,
+                                                  host_origin, region, tile->shape[1] * es, 0,
+                                                  host_pitch, 0, inputs[1],
+                                                  num_reuse, &slot->done, &writes[1]);
+            }
+        }
+        else
+        {
+            size_t host_origin[3] = {tile->in_origin[1] * es, tile->in_origin[0], 0};
+            size_t region[3] = {tile->in_shape[1] * es, tile->in_shape[0], 1};
+            status = clEnqueueWriteBufferRect(queue, slot->inputs[0], CL_FALSE, zero,
+                                              host_origin, region, tile->in_shape[1] * es, 0,
+                                              host_pitch, 0, inputs[0],
+                                              num_reuse, &slot->done, &writes[0]);
+        }
+
+        if (status == CL_SUCCESS)
+            status = launch(queue, tile, slot->inputs, slot->output, num_inputs, writes,
+                            &kernel_done, user_data);
+
+        if (slot->done)
+        {
+            clReleaseEvent(slot->done);
+            slot->done = NULL;
+        }
+
+        if (status == CL_SUCCESS)
+        {
+            size_t host_origin[3] = {tile->origin[1] * es, tile->origin[0], 0};
+            size_t region[3] = {tile->shape[1] * es, tile->shape[0], 1};
+            status = clEnqueueReadBufferRect(queue, slot->output, CL_FALSE, zero, host_origin,
+                                             region, tile->shape[1] * es, 0, host_pitch, 0,
+                                             output, 1, &kernel_done, &slot->done);
+        }
+
+        for (cl_uint i = 0; i < num_inputs; i++)
+            if (writes[i])
+                clReleaseEvent(writes[i]);
+        if (kernel_done)
+            clReleaseEvent(kernel_done);
+
+        if (status == CL_SUCCESS)
+            status = clFlush(queue);
+    }
+
+    if (status != CL_SUCCESS)
+        clFinish(queue); // Nothing may still reference the slots below.
+
+    for (unsigned int s = 0; s < OCL_TILE_BUFFERS; s++)
+    {
+        if (slots[s].done)
+        {
+            cl_int wait_status = clWaitForEvents(1, &slots[s].done);
+            if (status == CL_SUCCESS)
+                status = wait_status;
+            clReleaseEvent(slots[s].done);
+        }
+        for (cl_uint i = 0; i < 2; i++)
+            if (slots[s].inputs[i])
+                clReleaseMemObject(slots[s].inputs[i]);
+        if (slots[s].output)
+            clReleaseMemObject(slots[s].output);
+    }
+
+    return status;
+}
+
+cl_int OclRunTiledGemm(cl_context context, cl_command_queue queue, const OclTilePlan *plan,
+                       const Matrix *a, const Matrix *b, Matrix *c,
+                       OclTileLaunchFn launch, void *user_data)
+{
+    if (plan->kind != OCL_TILE_GEMM || plan->elem_size != sizeof(int))
+        return CL_INVALID_VALUE;
+    if (a->shape[0] != plan->shape[0] || a->shape[1] != plan->inner ||
+        b->shape[0] != plan->inner || b->shape[1] != plan->shape[1] ||
+        c->shape[0] != plan->shape[0] || c->shape[1] != plan->shape[1])
+    {
+        printf("!!INCORRECT SHAPE!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    const int *inputs[2] = {a->data, b->data};
+    return OclRunTiles(context, queue, plan, inputs, c->data, launch, user_data);
+}
+
+cl_int OclRunTiledStencil(cl_context context, cl_command_queue queue, const OclTilePlan *plan,
+                          const Image *input, Image *output,
+                          OclTileLaunchFn launch, void *user_data)
+{
+    if (plan->kind != OCL_TILE_STENCIL || plan->elem_size != sizeof(int) * IMAGE_CHANNELS)
+        return CL_INVALID_VALUE;
+    if (input->shape[0] != plan->shape[0] || input->shape[1] != plan->shape[1] ||
+        output->shape[0] != plan->shape[0] || output->shape[1] != plan->shape[1])
+    {
+        printf("!!INCORRECT SHAPE!!\n");
+        return CL_INVALID_VALUE;
+    }
+
+    const int *inputs[1] = {input->data};
+    return OclRunTiles(context, queue, plan, inputs, output->data, launch, user_data);
+}
+
+cl_int OclFreeTilePlan(OclTilePlan *plan)
+{
+    free(plan->tiles);
+    plan->tiles = NULL;
+    plan->num_tiles = 0;
+
+    return CL_SUCCESS;
+}
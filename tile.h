@@ -0,0 +1,129 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "device.h"
+#include "matrix.h"
+#include "img.h"
+
+#define OCL_TILE_BUFFERS 2   // Tiles in flight at once (double-buffering).
+#define OCL_TILE_ALIGN 16    // Tile edges are kept a multiple of this where possible.
+#define OCL_TILE_HEADROOM 8  // 1/OCL_TILE_HEADROOM of global memory is left to the driver.
+
+/**
+ * @brief The access pattern a tiling plan is built for.
+ */
+typedef enum _OclTileKind
+{
+    OCL_TILE_GEMM,    // C (rows x cols) = A (rows x inner) * B (inner x cols).
+    OCL_TILE_STENCIL, // Output (rows x cols) from an input of the same shape plus a halo.
+} OclTileKind;
+
+/**
+ * @brief A single tile of the output.
+ * For OCL_TILE_STENCIL, in_origin and in_shape describe the input region uploaded
+ * for the tile, i.e. the output region grown by the halo and clamped to the input.
+ */
+typedef struct _OclTile
+{
+    unsigned int origin[2];
+    unsigned int shape[2];
+    unsigned int in_origin[2];
+    unsigned int in_shape[2];
+} OclTile;
+
+/**
+ * @brief A tiling schedule that fits a job into device memory.
+ */
+typedef struct _OclTilePlan
+{
+    OclTileKind kind;
+    unsigned int shape[2];      // Output shape.
+    unsigned int inner;         // Shared dimension (OCL_TILE_GEMM only).
+    unsigned int halo;          // Halo width (OCL_TILE_STENCIL only).
+    size_t elem_size;           // Bytes per output element (e.g. sizeof(int) * IMAGE_CHANNELS).
+    unsigned int tile_shape[2]; // Largest tile extent.
+    size_t tile_bytes;          // Device bytes used by one tile in flight.
+    unsigned int num_buffers;   // Tiles in flight; 1 if the job fits in a single tile.
+    unsigned int num_tiles;
+    OclTile *tiles;
+} OclTilePlan;
+
+/**
+ * @brief Enqueues the kernel for one tile.
+ * The launch must wait on the given wait list and return its completion event in *event.
+ *
+ * @param queue The command queue the runner is using.
+ * @param tile The tile being computed.
+ * @param inputs The device input buffers. {A band, B band} for OCL_TILE_GEMM, {input region} for OCL_TILE_STENCIL.
+ * @param output The device output buffer, tile->shape[0] x tile->shape[1] densely packed.
+ * @param num_events_in_wait_list The number of events in event_wait_list.
+ * @param event_wait_list The events the launch must wait on.
+ * @param event The completion event of the launch.
+ * @param user_data The pointer passed to the runner.
+ *
+ * @return CL_SUCCESS if and only if the launch is enqueued.
+ */
+typedef cl_int (*OclTileLaunchFn)(cl_command_queue queue, const OclTile *tile,
+                                  const cl_mem *inputs, cl_mem output,
+                                  cl_uint num_events_in_wait_list, const cl_event *event_wait_list,
+                                  cl_event *event, void *user_data);
+
+/**
+ * @brief Builds a tiling schedule that respects the device's memory limits.
+ * The job is left in one tile if it fits.  Otherwise tiles are halved along their
+ * larger edge until OCL_TILE_BUFFERS tiles fit in global memory, and every buffer
+ * fits in a single allocation.
+ * reserved_bytes must also fit in constant memory.  Per-work-group local memory depends on the
+ * kernel's own blocking, so staying within local_mem_size is left to the launch callback.
+ * The caller is responsible for calling OclFreeTilePlan.
+ *
+ * @param device The target device.
+ * @param kind The access pattern of the job.
+ * @param shape The output shape (rows, cols).
+ * @param inner The shared dimension for OCL_TILE_GEMM.  Ignored otherwise.
+ * @param halo The halo width for OCL_TILE_STENCIL.  Ignored otherwise.
+ * @param elem_size The size of an element in bytes.
+ * @param reserved_bytes Bytes that stay resident for the whole job in constant memory
+ *                       (e.g. a convolution mask).
+ * @param plan The resulting plan.
+ *
+ * @return CL_SUCCESS if a plan is found.  CL_OUT_OF_RESOURCES if not even a 1x1 tile fits,
+ *         or reserved_bytes exceeds max_constant_buffer_size.
+ */
+cl_int OclPlanTiles(const OclDeviceProp *device, OclTileKind kind, const unsigned int shape[2],
+                    unsigned int inner, unsigned int halo, size_t elem_size,
+                    size_t reserved_bytes, OclTilePlan *plan);
+
+/**
+ * @brief Streams a GEMM through the device tile by tile.
+ * c->data must already be allocated with shape (a->shape[0], b->shape[1]).
+ *
+ * @return CL_SUCCESS if and only if every tile is computed and read back.
+ */
+cl_int OclRunTiledGemm(cl_context context, cl_command_queue queue, const OclTilePlan *plan,
+                       const Matrix *a, const Matrix *b, Matrix *c,
+                       OclTileLaunchFn launch, void *user_data);
+
+/**
+ * @brief Streams a stencil (e.g. a convolution) over an image tile by tile.
+ * output->data must already be allocated with the same shape as input.
+ *
+ * @return CL_SUCCESS if and only if every tile is computed and read back.
+ */
+cl_int OclRunTiledStencil(cl_context context, cl_command_queue queue, const OclTilePlan *plan,
+                          const Image *input, Image *output,
+                          OclTileLaunchFn launch, void *user_data);
+
+/**
+ * @brief Frees a tiling plan.
+ *
+ * @return CL_SUCCESS if and only if the plan is successfully freed.
+ */
+cl_int OclFreeTilePlan(OclTilePlan *plan);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,200 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "timing.h"
+
+#define MAD_TO_SIGMA 1.4826 // Scales the MAD to a standard deviation for normal data.
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int CompareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Median of a sorted array.
+ */
+static double Median(const double *sorted, unsigned int n)
+{
+    if (n % 2)
+        return sorted[n / 2];
+    return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+/**
+ * @brief Nearest-rank percentile of a sorted array.
+ */
+static double Percentile(const double *sorted, unsigned int n, double p)
+{
+    unsigned int rank = (unsigned int)ceil(p / 100.0 * n);
+    if (rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+cl_int OclComputeTimingStats(double *samples_ns, unsigned int num_samples,
+                             double flops, double bytes, OclTimingStats *stats)
+{
+    if (num_samples == 0)
+        return CL_INVALID_VALUE;
+
+    qsort(samples_ns, num_samples, sizeof(double), CompareDoubles);
+    double median = Median(samples_ns, num_samples);
+
+    double *deviations = (double *)malloc(num_samples * sizeof(double));
+    if (!deviations)
+        return CL_OUT_OF_HOST_MEMORY;
+    for (unsigned int i = 0; i < num_samples; i++)
+        deviations[i] = fabs(samples_ns[i] - median);
+    qsort(deviations, num_samples, sizeof(double), CompareDoubles);
+    double mad = Median(deviations, num_samples);
+    free(deviations);
+
+    // Keep the samples within OCL_TIMING_OUTLIER_Z robust standard deviations of the median.
+    // Samples stay sorted, so the kept ones are a contiguous range.
+    unsigned int first = 0;
+    unsigned int last = num_samples;
+    if (mad > 0)
+    {
+        double limit = OCL_TIMING_OUTLIER_Z * MAD_TO_SIGMA * mad;
+        while (median - samples_ns[first] > limit)
+            first++;
+        while (samples_ns[last - 1] - median > limit)
+            last--;
+    }
+
+    const double *kept = samples_ns + first;
+    unsigned int n = last - first;
+
+    double sum = 0;
+    for (unsigned int i = 0; i < n; i++)
+        sum += kept[i];
+    double mean = sum / n;
+
+    double squares = 0;
+    for (unsigned int i = 0; i < n; i++)
+        squares += (kept[i] - mean) * (kept[i] - mean);
+
+    stats->samples = n;
+    stats->rejected = num_samples - n;
+    stats->min_ns = kept[0];
+    stats->median_ns = Median(kept, n);
+    stats->p95_ns = Percentile(kept, n, 95);
+    stats->p99_ns = Percentile(kept, n, 99);
+    stats->mean_ns = mean;
+    stats->stddev_ns = n > 1 ? sqrt(squares / (n - 1)) : 0;
+    // Operations per nanosecond are billions of operations per second.
+    stats->gflops = stats->median_ns > 0 ? flops / stats->median_ns : 0;
+    stats->gbps = stats->median_ns > 0 ? bytes / stats->median_ns : 0;
+    stats->noisy = mean > 0 && stats->stddev_ns / mean > OCL_TIMING_NOISY_CV;
+    stats->profiled = false;
+
+    return CL_SUCCESS;
+}
+
+cl_int OclTimeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim,
+                     const size_t *global_size, const size_t *local_size,
+                     const OclTimingConfig *config, OclTimingStats *stats)
+{
+    cl_int status = CL_SUCCESS;
+    bool profiled = true;
+
+    if (config->iterations == 0)
+        return CL_INVALID_VALUE;
+
+    double *samples = (double *)malloc(config->iterations * sizeof(double));
+    if (!samples)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    for (unsigned int i = 0; i < config->warmup + config->iterations && status == CL_SUCCESS; i++)
+    {
+        cl_event event;
+        double start = NowNs();
+
+        status = clEnqueueNDRangeKernel(queue, kernel, work_dim, NULL, global_size, local_size,
+                                        0, NULL, &event);
+        if (status != CL_SUCCESS)
+            break;
+        status = clWaitForEvents(1, &event);
+        double end = NowNs();
+
+        if (status == CL_SUCCESS && i >= config->warmup)
+        {
+            double *sample = &samples[i - config->warmup];
+            *sample = end - start;
+
+            if (profiled)
+            {
+                cl_ulong queued, finished;
+                if (clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(queued), &queued, NULL) == CL_SUCCESS &&
+                    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(finished), &finished, NULL) == CL_SUCCESS)
+                    *sample = (double)(finished - queued);
+                else
+                    profiled = false; // Queue lacks CL_QUEUE_PROFILING_ENABLE; keep the host clock
+            }
+        }
+        clReleaseEvent(event);
+    }
+
+    if (status == CL_SUCCESS)
+        status = OclComputeTimingStats(samples, config->iterations, config->flops, config->bytes, stats);
+    if (status == CL_SUCCESS)
+        stats->profiled = profiled;
+
+    free(samples);
+    return status;
+}
+
+cl_int OclTimeHost(OclTimedFn fn, void *user_data, const OclTimingConfig *config,
+                   OclTimingStats *stats)
+{
+    cl_int status = CL_SUCCESS;
+
+    if (config->iterations == 0)
+        return CL_INVALID_VALUE;
+
+    double *samples = (double *)malloc(config->iterations * sizeof(double));
+    if (!samples)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    for (unsigned int i = 0; i < config->warmup + config->iterations && status == CL_SUCCESS; i++)
+    {
+        double start = NowNs();
+        status = fn(user_data);
+        double end = NowNs();
+
+        if (i >= config->warmup)
+            samples[i - config->warmup] = end - start;
+    }
+
+    if (status == CL_SUCCESS)
+        status = OclComputeTimingStats(samples, config->iterations, config->flops, config->bytes, stats);
+
+    free(samples);
+    return status;
+}
+
+void OclPrintTimingStats(const char *label, const OclTimingStats *stats)
+{
+    printf("%s (%u samples, %u rejected, %s):\n", label, stats->samples, stats->rejected,
+           stats->profiled ? "profiling events" : "host clock");
+    printf("\tmin %.3f us, median %.3f us, p95 %.3f us, p99 %.3f us, stddev %.3f us\n",
+           stats->min_ns / 1e3, stats->median_ns / 1e3, stats->p95_ns / 1e3, stats->p99_ns / 1e3,
+           stats->stddev_ns / 1e3);
+    if (stats->gflops > 0 || stats->gbps > 0)
+        printf("\t%.3f GFLOP/s, %.3f GB/s\n", stats->gflops, stats->gbps);
+
+    if (stats->noisy)
+        printf("\033[33mWarning: stddev is %.1f%% of the mean; results are too noisy to trust.\033[0m\n",
+               100.0 * stats->stddev_ns / stats->mean_ns);
+}
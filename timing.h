@@ -0,0 +1,90 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#ifdef __APPLE__
+#include <OpenCL/cl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 300 // Use OpenCL 3.0
+#include <CL/cl.h>
+#endif
+
+#define OCL_TIMING_OUTLIER_Z 3.5 // Modified z-score above which a sample is rejected.
+#define OCL_TIMING_NOISY_CV 0.05 // Coefficient of variation above which results are flagged.
+
+/**
+ * @brief How many times to run the code under test.
+ * flops and bytes are per iteration and only used for the derived rates.  Leave them 0 to skip.
+ */
+typedef struct _OclTimingConfig
+{
+    unsigned int warmup;
+    unsigned int iterations;
+    double flops;
+    double bytes;
+} OclTimingConfig;
+
+/**
+ * @brief Summary of a timing run.  Times are in nanoseconds and computed after outlier rejection.
+ */
+typedef struct _OclTimingStats
+{
+    unsigned int samples;
+    unsigned int rejected;
+    double min_ns;
+    double median_ns;
+    double p95_ns;
+    double p99_ns;
+    double mean_ns;
+    double stddev_ns;
+    double gflops; // At the median time.
+    double gbps;   // At the median time.
+    bool noisy;    // True if stddev / mean exceeds OCL_TIMING_NOISY_CV.
+    bool profiled; // True if times come from profiling events rather than the host clock.
+} OclTimingStats;
+
+/**
+ * @brief A host function to time, e.g. a wrapper around LoadMatrix.
+ */
+typedef cl_int (*OclTimedFn)(void *user_data);
+
+/**
+ * @brief Computes statistics from raw samples, rejecting outliers by median absolute deviation.
+ * The samples are sorted in place.
+ *
+ * @return CL_SUCCESS if and only if there is at least one sample.
+ */
+cl_int OclComputeTimingStats(double *samples_ns, unsigned int num_samples,
+                             double flops, double bytes, OclTimingStats *stats);
+
+/**
+ * @brief Times a kernel launch.
+ * Uses profiling events if queue was created with CL_QUEUE_PROFILING_ENABLE, and
+ * CLOCK_MONOTONIC around the launch and its completion otherwise.
+ *
+ * @return CL_SUCCESS if and only if every launch succeeds.
+ */
+cl_int OclTimeKernel(cl_command_queue queue, cl_kernel kernel, cl_uint work_dim,
+                     const size_t *global_size, const size_t *local_size,
+                     const OclTimingConfig *config, OclTimingStats *stats);
+
+/**
+ * @brief Times a host function with CLOCK_MONOTONIC.
+ *
+ * @return CL_SUCCESS if and only if every call returns CL_SUCCESS.
+ */
+cl_int OclTimeHost(OclTimedFn fn, void *user_data, const OclTimingConfig *config,
+                   OclTimingStats *stats);
+
+/**
+ * @brief Prints a timing summary, with a warning if it is too noisy to trust.
+ */
+void OclPrintTimingStats(const char *label, const OclTimingStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,460 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "kernel.h"
+#include "worker.h"
+
+static cl_ulong NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (cl_ulong)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Apple: SO_NOSIGPIPE is set on each socket instead.
+#endif
+
+/**
+ * @brief Makes writes to a peer that has gone away fail with EPIPE instead of raising SIGPIPE,
+ * without changing the host process's signal handlers.
+ */
+static void NoSigPipe(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#else
+    (void)fd;
+#endif
+}
+
+static cl_int WriteAll(int fd, const void *buf, size_t size)
+{
+    const char *p = (const char *)buf;
+    while (size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return CL_INVALID_VALUE;
+        p += n;
+        size -= n;
+    }
+    return CL_SUCCESS;
+}
+
+static cl_int ReadAll(int fd, void *buf, size_t size)
+{
+    char *p = (char *)buf;
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return CL_INVALID_VALUE; // Error or peer closed
+        p += n;
+        size -= n;
+    }
+    return CL_SUCCESS;
+}
+
+cl_int OclCreateWorker(OclWorker *worker, cl_device_type device_type)
+{
+    cl_int status;
+
+    memset(worker, 0, sizeof(*worker));
+
+    status = OclGetDeviceWithFallback(&worker->device_id, device_type);
+    if (status != CL_SUCCESS)
+        return status;
+
+    worker->context = clCreateContext(NULL, 1, &worker->device_id, NULL, NULL, &status);
+    if (status != CL_SUCCESS)
+        return status;
+
+    worker->queue = OclCreateCommandQueue(worker->context, worker->device_id, 0, &status);
+    if (status != CL_SUCCESS)
+    {
+        OclReleaseWorker(worker);
+        return status;
+    }
+
+    status = CreateReservedArena(OCL_WORKER_ARENA_SIZE, &worker->arena);
+    if (status != CL_SUCCESS)
+        OclReleaseWorker(worker);
+
+    return status;
+}
+
+/**
+ * @brief Looks up a built program by source path, building and caching it on a miss.
+ * A cached program is rebuilt if its source's modification time or size has changed.
+ */
+static cl_int OclWorkerGetProgram(OclWorker *worker, const char *path, cl_program *program,
+                                  cl_ulong *build_ns)
+{
+    OclWorkerProgram *entry = NULL;
+    struct stat st;
+    cl_int status;
+
+    *build_ns = 0;
+    if (stat(path, &st) != 0)
+        return CL_INVALID_VALUE;
+
+    for (cl_uint i = 0; i < worker->num_programs; i++)
+    {
+        if (strcmp(worker->programs[i].path, path) == 0)
+        {
+            entry = &worker->programs[i];
+            if (entry->mtime == st.st_mtime && entry->size == st.st_size)
+            {
+                *program = entry->program;
+                return CL_SUCCESS;
+            }
+            break; // Edited since it was built
+        }
+    }
+
+    if (!entry && worker->num_programs == OCL_WORKER_MAX_PROGRAMS)
+        return CL_OUT_OF_RESOURCES;
+
+    cl_ulong start = NowNs();
+
+    char *source = OclLoadKernel(path);
+    if (!source)
+        return CL_INVALID_VALUE;
+
+    cl_program built = clCreateProgramWithSource(worker->context, 1, (const char **)&source, NULL, &status);
+    free(source);
+    if (status != CL_SUCCESS)
+        return status;
+
+    status = clBuildProgram(built, 1, &worker->device_id, NULL, NULL, NULL);
+    if (status != CL_SUCCESS)
+    {
+        char log[4096];
+        if (clGetProgramBuildInfo(built, worker->device_id, CL_PROGRAM_BUILD_LOG, sizeof(log), log, NULL) == CL_SUCCESS)
+            fprintf(stderr, "%s\n", log);
+        clReleaseProgram(built);
+        return status;
+    }
+
+    if (entry)
+    {
+        clReleaseProgram(entry->program);
+    }
+    else
+    {
+        entry = &worker->programs[worker->num_programs++];
+        strncpy(entry->path, path, OCL_WORKER_MAX_PATH - 1);
+        entry->path[OCL_WORKER_MAX_PATH - 1] = '\0';
+    }
+    entry->program = built;
+    entry->mtime = st.st_mtime;
+    entry->size = st.st_size;
+
+    *program = built;
+    *build_ns = NowNs() - start;
+
+    return CL_SUCCESS;
+}
+
+cl_int OclWorkerRunJob(OclWorker *worker, const OclWorkerJob *job, OclWorkerResult *result,
+                       Matrix *output)
+{
+    cl_mem inputs[OCL_WORKER_MAX_INPUTS] = {0};
+    cl_mem output_buffer = NULL;
+    cl_kernel kernel = NULL;
+    cl_program program;
+    Matrix host_output = {NULL, {job->output_shape[0], job->output_shape[1]}};
+    cl_int status = CL_SUCCESS;
+
+    cl_ulong start = NowNs();
+
+    result->shape[0] = job->output_shape[0];
+    result->shape[1] = job->output_shape[1];
+    result->setup_ns = 0;
+    result->run_ns = 0;
+
+    if (job->num_inputs > OCL_WORKER_MAX_INPUTS || job->num_scalars > OCL_WORKER_MAX_SCALARS)
+        status = CL_INVALID_VALUE;
+
+    if (status == CL_SUCCESS)
+        status = OclWorkerGetProgram(worker, job->kernel_path, &program, &result->setup_ns);
+    if (status == CL_SUCCESS)
+        kernel = clCreateKernel(program, job->kernel_name, &status);
+
+    for (cl_uint i = 0; i < job->num_inputs && status == CL_SUCCESS; i++)
+    {
+        Matrix input;
+        status = LoadMatrixFromArena(job->input_paths[i], &input, &worker->arena);
+        if (status == CL_SUCCESS)
+            inputs[i] = clCreateBuffer(worker->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                       sizeof(int) * input.shape[0] * input.shape[1], input.data, &status);
+        if (status == CL_SUCCESS)
+            status = clSetKernelArg(kernel, i, sizeof(cl_mem), &inputs[i]);
+    }
+
+    size_t output_size = sizeof(int) * job->output_shape[0] * job->output_shape[1];
+    if (status == CL_SUCCESS)
+    {
+        host_output.data = (int *)malloc(output_size);
+        if (!host_output.data)
+            status = CL_OUT_OF_HOST_MEMORY;
+    }
+    if (status == CL_SUCCESS)
+        output_buffer = clCreateBuffer(worker->context, CL_MEM_WRITE_ONLY, output_size, NULL, &status);
+    if (status == CL_SUCCESS)
+        status = clSetKernelArg(kernel, job->num_inputs, sizeof(cl_mem), &output_buffer);
+
+    for (cl_uint i = 0; i < job->num_scalars && status == CL_SUCCESS; i++)
+        status = clSetKernelArg(kernel, job->num_inputs + 1 + i, sizeof(cl_int), &job->scalars[i]);
+
+    if (status == CL_SUCCESS)
+    {
+        const size_t *local_size = job->local_size[0] ? job->local_size : NULL;
+        status = clEnqueueNDRangeKernel(worker->queue, kernel, 2, NULL, job->global_size, local_size,
+                                        0, NULL, NULL);
+    }
+    if (status == CL_SUCCESS)
+        status = clEnqueueReadBuffer(worker->queue, output_buffer, CL_TRUE, 0, output_size,
+                                     host_output.data, 0, NULL, NULL);
+
+    if (status == CL_SUCCESS && job->output_path[0])
+        status = SaveMatrix(job->output_path, &host_output);
+
+    if (status == CL_SUCCESS && !job->output_path[0] && output)
+        *output = host_output;
+    else
+        FreeMatrix(&host_output);
+
+    for (cl_uint i = 0; i < OCL_WORKER_MAX_INPUTS; i++)
+        if (inputs[i])
+            clReleaseMemObject(inputs[i]);
+    if (output_buffer)
+        clReleaseMemObject(output_buffer);
+    if (kernel)
+        clReleaseKernel(kernel);
+    ResetArena(&worker->arena);
+
+    result->run_ns = NowNs() - start - result->setup_ns;
+    result->status = status;
+
+    return status;
+}
+
+cl_int OclReleaseWorker(OclWorker *worker)
+{
+    for (cl_uint i = 0; i < worker->num_programs; i++)
+        clReleaseProgram(worker->programs[i].program);
+    worker->num_programs = 0;
+
+    if (worker->queue)
+        clReleaseCommandQueue(worker->queue);
+    if (worker->context)
+        clReleaseContext(worker->context);
+    worker->queue = NULL;
+    worker->context = NULL;
+
+    return ReleaseArena(&worker->arena);
+}
+
+/**
+ * @brief Serves jobs from one client until it disconnects or asks the worker to exit.
+ *
+ * @return true if the worker should shut down.
+ */
+static bool OclServeClient(OclWorker *worker, int fd)
+{
+    OclWorkerJob job;
+
+    while (ReadAll(fd, &job, sizeof(job)) == CL_SUCCESS)
+    {
+        if (job.command == OCL_WORKER_SHUTDOWN)
+            return true;
+
+        // Never trust string fields from the wire to be terminated.
+        job.kernel_path[OCL_WORKER_MAX_PATH - 1] = '\0';
+        job.kernel_name[OCL_WORKER_MAX_NAME - 1] = '\0';
+        job.output_path[OCL_WORKER_MAX_PATH - 1] = '\0';
+        for (cl_uint i = 0; i < OCL_WORKER_MAX_INPUTS; i++)
+            job.input_paths[i][OCL_WORKER_MAX_PATH - 1] = '\0';
+
+        OclWorkerResult result;
+        Matrix output = {NULL, {0, 0}};
+        OclWorkerRunJob(worker, &job, &result, &output);
+
+        cl_int status = WriteAll(fd, &result, sizeof(result));
+        if (status == CL_SUCCESS && result.status == CL_SUCCESS && !job.output_path[0])
+            status = WriteAll(fd, output.data, sizeof(int) * output.shape[0] * output.shape[1]);
+        FreeMatrix(&output);
+
+        if (status != CL_SUCCESS)
+            break;
+    }
+
+    return false;
+}
+
+cl_int OclServeWorker(OclWorker *worker, const char *socket_path)
+{
+    struct sockaddr_un addr;
+    int server;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        return CL_INVALID_VALUE;
+
+    server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        return CL_INVALID_VALUE;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    // Remove a stale socket from a previous run, but never anything else.
+    struct stat st;
+    if (lstat(socket_path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "'%s' exists and is not a socket\n", socket_path);
+            close(server);
+            return CL_INVALID_VALUE;
+        }
+        unlink(socket_path);
+    }
+
+    // Jobs read and write files with the worker's privileges, so only its owner may connect.
+    // The umask makes the socket 0600 from the moment it is created.
+    mode_t old_mask = umask(0077);
+    int bound = bind(server, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+
+    if (bound != 0 || listen(server, 8) != 0)
+    {
+        fprintf(stderr, "Unable to listen on '%s'\n", socket_path);
+        close(server);
+        return CL_INVALID_VALUE;
+    }
+
+    bool shutdown = false;
+    while (!shutdown)
+    {
+        int client = accept(server, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        NoSigPipe(client);
+        shutdown = OclServeClient(worker, client);
+        close(client);
+    }
+
+    close(server);
+    unlink(socket_path);
+
+    return shutdown ? CL_SUCCESS : CL_INVALID_VALUE;
+}
+
+cl_int OclRunJobCold(const OclWorkerJob *job, OclWorkerResult *result, Matrix *output)
+{
+    OclWorker worker;
+    cl_int status;
+
+    cl_ulong start = NowNs();
+    status = OclCreateWorker(&worker, OCL_DEVICE_TYPE);
+    cl_ulong create_ns = NowNs() - start;
+
+    if (status != CL_SUCCESS)
+    {
+        result->status = status;
+        result->setup_ns = create_ns;
+        result->run_ns = 0;
+        return status;
+    }
+
+    status = OclWorkerRunJob(&worker, job, result, output);
+    OclReleaseWorker(&worker);
+
+    result->setup_ns += create_ns;
+
+    return status;
+}
+
+cl_int OclWorkerConnect(const char *socket_path, int *fd)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        return CL_INVALID_VALUE;
+
+    *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (*fd < 0)
+        return CL_INVALID_VALUE;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    if (connect(*fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(*fd);
+        *fd = -1;
+        return CL_INVALID_VALUE;
+    }
+    NoSigPipe(*fd);
+
+    return CL_SUCCESS;
+}
+
+cl_int OclWorkerSubmit(int fd, const OclWorkerJob *job, OclWorkerResult *result, Matrix *output)
+{
+    cl_int status;
+
+    status = WriteAll(fd, job, sizeof(*job));
+    if (status == CL_SUCCESS)
+        status = ReadAll(fd, result, sizeof(*result));
+    if (status != CL_SUCCESS)
+        return status;
+
+    if (result->status != CL_SUCCESS || job->output_path[0])
+        return result->status;
+
+    output->shape[0] = result->shape[0];
+    output->shape[1] = result->shape[1];
+    output->data = (int *)malloc(sizeof(int) * output->shape[0] * output->shape[1]);
+    if (!output->data)
+        return CL_OUT_OF_HOST_MEMORY;
+
+    status = ReadAll(fd, output->data, sizeof(int) * output->shape[0] * output->shape[1]);
+    if (status != CL_SUCCESS)
+        FreeMatrix(output);
+
+    return status;
+}
+
+cl_int OclWorkerShutdown(int fd)
+{
+    OclWorkerJob job;
+
+    memset(&job, 0, sizeof(job));
+    job.command = OCL_WORKER_SHUTDOWN;
+
+    cl_int status = WriteAll(fd, &job, sizeof(job));
+    close(fd);
+
+    return status;
+}
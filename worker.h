@@ -0,0 +1,150 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "arena.h"
+#include "device.h"
+#include "matrix.h"
+
+#define OCL_WORKER_MAX_PATH 256
+#define OCL_WORKER_MAX_NAME 64
+#define OCL_WORKER_MAX_INPUTS 4
+#define OCL_WORKER_MAX_SCALARS 8
+#define OCL_WORKER_MAX_PROGRAMS 16
+#ifndef OCL_WORKER_ARENA_SIZE
+#define OCL_WORKER_ARENA_SIZE (1UL << 30) // Reserved, not committed, address space for job inputs.
+#endif
+
+typedef enum _OclWorkerCommand
+{
+    OCL_WORKER_RUN,
+    OCL_WORKER_SHUTDOWN,
+} OclWorkerCommand;
+
+/**
+ * @brief A job for a resident worker.
+ * The kernel is called as kernel(input_0, ..., input_n, output, scalar_0, ..., scalar_m),
+ * where inputs and output are __global int* buffers holding dense row-major matrices.
+ */
+typedef struct _OclWorkerJob
+{
+    OclWorkerCommand command;
+    char kernel_path[OCL_WORKER_MAX_PATH];
+    char kernel_name[OCL_WORKER_MAX_NAME];
+    cl_uint num_inputs;
+    char input_paths[OCL_WORKER_MAX_INPUTS][OCL_WORKER_MAX_PATH];
+    char output_path[OCL_WORKER_MAX_PATH]; // Empty to stream the output back instead of saving it.
+    unsigned int output_shape[2];
+    cl_uint num_scalars;
+    cl_int scalars[OCL_WORKER_MAX_SCALARS];
+    size_t global_size[2];
+    size_t local_size[2]; // {0, 0} lets the runtime choose.
+} OclWorkerJob;
+
+/**
+ * @brief The outcome of a job.
+ * setup_ns covers platform discovery, context creation and program builds done for this job,
+ * which is zero for warm runs of an already built kernel.
+ */
+typedef struct _OclWorkerResult
+{
+    cl_int status;
+    unsigned int shape[2];
+    cl_ulong setup_ns;
+    cl_ulong run_ns;
+} OclWorkerResult;
+
+typedef struct _OclWorkerProgram
+{
+    char path[OCL_WORKER_MAX_PATH];
+    time_t mtime; // Source modification time and size when built; a change triggers a rebuild.
+    off_t size;
+    cl_program program;
+} OclWorkerProgram;
+
+/**
+ * @brief The state a resident worker keeps between jobs.
+ */
+typedef struct _OclWorker
+{
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+    HostArena arena; // Job inputs; reset after every job.
+    cl_uint num_programs;
+    OclWorkerProgram programs[OCL_WORKER_MAX_PROGRAMS];
+} OclWorker;
+
+/**
+ * @brief Selects a device and creates the context and queue a worker keeps for its lifetime.
+ * The caller is responsible for calling OclReleaseWorker.
+ *
+ * @return CL_SUCCESS if and only if the worker is ready to run jobs.
+ */
+cl_int OclCreateWorker(OclWorker *worker, cl_device_type device_type);
+
+/**
+ * @brief Runs a job on a worker, building and caching its program on first use.
+ * The program is rebuilt if its source file's modification time or size changes.
+ * If job->output_path is empty, output receives the result and must be freed with FreeMatrix.
+ *
+ * @return CL_SUCCESS if and only if the job ran.  The same status is stored in result->status.
+ */
+cl_int OclWorkerRunJob(OclWorker *worker, const OclWorkerJob *job, OclWorkerResult *result,
+                       Matrix *output);
+
+/**
+ * @brief Releases a worker's programs, queue, context and arena.
+ *
+ * @return CL_SUCCESS if and only if the worker is successfully released.
+ */
+cl_int OclReleaseWorker(OclWorker *worker);
+
+/**
+ * @brief Serves jobs on a Unix domain socket until a client sends OCL_WORKER_SHUTDOWN.
+ * Clients are served one at a time; each may submit any number of jobs.
+ *
+ * Every client is trusted: a job names kernel, input and output paths that the worker opens
+ * with its own privileges.  The socket is therefore created with mode 0600, so only the
+ * worker's owner can connect.  Do not loosen its permissions or serve it from a shared account.
+ * A stale socket at socket_path is replaced; any other file there is left alone.
+ *
+ * @return CL_SUCCESS on shutdown.  CL_INVALID_VALUE if the socket cannot be bound.
+ */
+cl_int OclServeWorker(OclWorker *worker, const char *socket_path);
+
+/**
+ * @brief Runs a job the way a standalone program would: discover, create, build, run, release.
+ * The reference for the latency the resident worker saves.
+ */
+cl_int OclRunJobCold(const OclWorkerJob *job, OclWorkerResult *result, Matrix *output);
+
+/**
+ * @brief Connects to a worker.
+ *
+ * @return CL_SUCCESS if and only if *fd is a connected socket.
+ */
+cl_int OclWorkerConnect(const char *socket_path, int *fd);
+
+/**
+ * @brief Submits a job to a worker and waits for its result.
+ * If job->output_path is empty, the output is streamed back into output, which must be freed
+ * with FreeMatrix.
+ *
+ * @return The job's status, or CL_INVALID_VALUE if the connection fails.
+ */
+cl_int OclWorkerSubmit(int fd, const OclWorkerJob *job, OclWorkerResult *result, Matrix *output);
+
+/**
+ * @brief Asks a worker to exit and closes the connection.
+ */
+cl_int OclWorkerShutdown(int fd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "worker.h"
+
+#define BENCH_ITERATIONS 20
+
+static void Usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "  %s SOCKET\n"
+            "      Serve jobs on SOCKET until a client sends a shutdown.\n"
+            "  %s --bench SOCKET KERNEL_PATH KERNEL_NAME ROWS COLS INPUT...\n"
+            "      Compare a cold run of the job with warm runs on the worker at SOCKET.\n",
+            argv0, argv0);
+}
+
+static double NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int Bench(int argc, char **argv)
+{
+    OclWorkerJob job;
+    OclWorkerResult result;
+    Matrix output;
+    int fd;
+
+    memset(&job, 0, sizeof(job));
+    job.command = OCL_WORKER_RUN;
+    strncpy(job.kernel_path, argv[3], OCL_WORKER_MAX_PATH - 1);
+    strncpy(job.kernel_name, argv[4], OCL_WORKER_MAX_NAME - 1);
+    job.output_shape[0] = atoi(argv[5]);
+    job.output_shape[1] = atoi(argv[6]);
+    job.global_size[0] = job.output_shape[1];
+    job.global_size[1] = job.output_shape[0];
+    job.num_inputs = argc - 7;
+    if (job.num_inputs > OCL_WORKER_MAX_INPUTS)
+    {
+        fprintf(stderr, "At most %d inputs are supported\n", OCL_WORKER_MAX_INPUTS);
+        return 1;
+    }
+    for (cl_uint i = 0; i < job.num_inputs; i++)
+        strncpy(job.input_paths[i], argv[7 + i], OCL_WORKER_MAX_PATH - 1);
+
+    double start = NowMs();
+    cl_int status = OclRunJobCold(&job, &result, &output);
+    double cold_ms = NowMs() - start;
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Cold run failed (%d)\n", status);
+        return 1;
+    }
+    FreeMatrix(&output);
+
+    if (OclWorkerConnect(argv[2], &fd) != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to connect to '%s'\n", argv[2]);
+        return 1;
+    }
+
+    // The first warm run may still build the program; report it separately.
+    double warm_ms[BENCH_ITERATIONS + 1];
+    for (int i = 0; i <= BENCH_ITERATIONS; i++)
+    {
+        start = NowMs();
+        status = OclWorkerSubmit(fd, &job, &result, &output);
+        warm_ms[i] = NowMs() - start;
+        if (status != CL_SUCCESS)
+        {
+            fprintf(stderr, "Warm run failed (%d)\n", status);
+            return 1;
+        }
+        FreeMatrix(&output);
+    }
+
+    double best = warm_ms[1], total = 0;
+    for (int i = 1; i <= BENCH_ITERATIONS; i++)
+    {
+        total += warm_ms[i];
+        if (warm_ms[i] < best)
+            best = warm_ms[i];
+    }
+
+    printf("Cold run:        %.3f ms\n", cold_ms);
+    printf("First warm run:  %.3f ms\n", warm_ms[0]);
+    printf("Warm runs:       %.3f ms mean, %.3f ms min over %d runs\n",
+           total / BENCH_ITERATIONS, best, BENCH_ITERATIONS);
+
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 8 && strcmp(argv[1], "--bench") == 0)
+        return Bench(argc, argv);
+
+    if (argc != 2)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    OclWorker worker;
+    cl_int status = OclCreateWorker(&worker, OCL_DEVICE_TYPE);
+    if (status != CL_SUCCESS)
+    {
+        fprintf(stderr, "Unable to create worker (%d)\n", status);
+        return 1;
+    }
+
+    status = OclServeWorker(&worker, argv[1]);
+    OclReleaseWorker(&worker);
+
+    return status == CL_SUCCESS ? 0 : 1;
+}